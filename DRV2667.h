@@ -4,14 +4,84 @@
 
 #include <Wire.h>
 #include "DRV2667/Effect.h"
+#include "DRV2667/RamImage.h"
+
+// 1 : every DRV2667 embeds its own Effects store (a RAM image of DRV2667_RAM_BYTES each)
+// 0 : drivers work on a store set with useEffects() or DeviceArray(Effects&), e.g. one library for many devices
+#ifndef DRV2667_EMBED_EFFECTS
+    #define DRV2667_EMBED_EFFECTS 1
+#endif
+
+// per-register / error / latency counters of every I2C transaction (DRV2667::getStats())
+#ifndef DRV2667_ENABLE_STATS
+    #define DRV2667_ENABLE_STATS 0
+#endif
+
+// max bytes in one TwoWire transaction (including register address)
+#ifndef DRV2667_I2C_BUFFER_LENGTH
+    #if defined(I2C_BUFFER_LENGTH)
+        #define DRV2667_I2C_BUFFER_LENGTH I2C_BUFFER_LENGTH
+    #elif defined(BUFFER_LENGTH)
+        #define DRV2667_I2C_BUFFER_LENGTH BUFFER_LENGTH
+    #else
+        #define DRV2667_I2C_BUFFER_LENGTH 32
+    #endif
+#endif
 
 namespace EmbeddedDevices
 {
     namespace DRV2667
     {
+        // reg : register (or RAM offset) of the failed transaction, status : as getI2CStatus()
+        using ErrorSink = void (*)(const uint8_t reg, const uint8_t status, void* context);
+
+        // error sink with the behavior of earlier versions (blocking Serial output)
+        inline void printErrorToSerial(const uint8_t reg, const uint8_t status, void*)
+        {
+            Serial.print("I2C error : ");
+            Serial.print(status);
+            Serial.print(" at reg ");
+            Serial.println(reg);
+        }
+
+#if DRV2667_ENABLE_STATS
+        struct Stats
+        {
+            static const uint8_t NUM_REGS = 0x0C;
+
+            uint32_t reg_writes[NUM_REGS]; // successful writes starting at control register 0x00 - 0x0B
+            uint32_t page_writes;          // writes to page register 0xFF
+            uint32_t ram_writes;           // burst writes into RAM pages
+            uint32_t reads;
+            uint32_t bytes_written;        // payload bytes (register address excluded)
+            uint32_t bytes_read;
+            uint32_t transactions;         // including retries and failed ones
+            uint32_t errors[5];            // by endTransmission() code 1 - 4 (errors[0] : unused)
+            uint32_t retries;
+            uint32_t latency_min_us;
+            uint32_t latency_max_us;
+            uint32_t latency_sum_us;
+
+            uint32_t latencyAvgUs() const { return transactions ? latency_sum_us / transactions : 0; }
+            uint32_t errorCount() const { return errors[1] + errors[2] + errors[3] + errors[4]; }
+
+            void record(const uint32_t us, const uint8_t status)
+            {
+                if (transactions == 0 || us < latency_min_us) latency_min_us = us;
+                if (us > latency_max_us) latency_max_us = us;
+                latency_sum_us += us;
+                ++transactions;
+                if (status != 0) ++errors[(status < 5) ? status : 4];
+            }
+        };
+#endif
+
         class DRV2667
         {
-            static const uint8_t I2C_ADDR = 0x59;
+            static const uint16_t RAM_PAGE_BYTES = 256;
+            static const uint8_t FIFO_REG = 0x0B;
+            static const uint8_t PAGE_REG = 0xFF;
+            static const uint8_t SEQUENCE_REG = 0x03;
 
         public:
 
@@ -19,7 +89,21 @@ namespace EmbeddedDevices
             enum class Input { DIGITAL_IN, ANALOG_IN };
             enum class Timeout { MS_5, MS_10, MS_15, MS_20 };
 
-            void attatch(TwoWire& w = Wire) { wire = &w; }
+            static const uint8_t SEQUENCE_SIZE = 8;
+            static const uint8_t I2C_ADDR = 0x59;
+
+            DRV2667() {}
+            // a copy would keep working on the effects store of the original
+            DRV2667(const DRV2667&) = delete;
+            DRV2667& operator=(const DRV2667&) = delete;
+
+            void attatch(TwoWire& w = Wire, const uint8_t addr = I2C_ADDR)
+            {
+                wire = &w;
+                addr_ = addr;
+            }
+            TwoWire& getWire() const { return *wire; }
+            uint8_t getAddress() const { return addr_; }
 
             void play()
             {
@@ -50,49 +134,69 @@ namespace EmbeddedDevices
 
             void gain(const Gain g)
             {
-                reg_01 &= (0xFF & (uint8_t)g);
-                write(0x01, reg_01);
+                setField(0x01, 0x03, (uint8_t)g);
             }
 
 
             void selectInput(const Input input)
             {
-                if ((bool)input) reg_01 |= (1 << 2);
-                else             reg_01 &= ~(1 << 2);
-                write(0x01, reg_01);
+                setField(0x01, (1 << 2), (bool)input ? (1 << 2) : 0);
             }
 
+            // GO self-clears on the chip : always written, together with pending changes of 0x02
             void go()
             {
-                reg_02 |= 0x01;
-                write(0x02, reg_02);
+                setMemoryPage(0x00);
+                write(0x02, regs_[0x02] | 0x01);
+                if (status_ == 0)
+                {
+                    valid_ |= (1 << 0x02);
+                    dirty_ &= ~(1 << 0x02);
+                }
+            }
+
+            // GO reads back set until the sequence has finished
+            bool isPlaying()
+            {
+                setMemoryPage(0x00);
+                const uint16_t v = read(0x02);
+                return (status_ == 0) && (v & 0x01);
+            }
+
+            // clearing GO stops the sequence
+            void stop()
+            {
+                setMemoryPage(0x00);
+                write(0x02, regs_[0x02]);
             }
 
             void boost(const bool b)
             {
-                if (b) reg_02 |= (1 << 1); // EN_OVERRIDE
-                else   reg_02 &= ~(1 << 1);
-                write(0x02, reg_02);
+                setField(0x02, (1 << 1), b ? (1 << 1) : 0); // EN_OVERRIDE
             }
 
 
             void timeout(const Timeout timeout)
             {
-                reg_02 |= ((uint8_t)timeout << 2);
-                write(0x02, reg_02);
+                setField(0x02, (0x03 << 2), ((uint8_t)timeout << 2));
             }
 
             void standby(bool b)
             {
-                if (b) reg_02 |= (1 << 6);
-                else   reg_02 &= ~(1 << 6);
-                write(0x02, reg_02);
+                setField(0x02, (1 << 6), b ? (1 << 6) : 0);
             }
 
+            // DEV_RST self-clears; all registers and the page return to their defaults
             void reset()
             {
-                reg_02 |= (1 << 7);
-                write(0x02, reg_02);
+                setMemoryPage(0x00);
+                write(0x02, regs_[0x02] | (1 << 7));
+                for (uint8_t i = 0; i < NUM_REGS; ++i) regs_[i] = 0x00;
+                regs_[0x01] = 0x38;
+                regs_[0x02] = 0x40;
+                valid_ = (status_ == 0) ? REG_WRITABLE : 0;
+                dirty_ = 0;
+                page_ = (status_ == 0) ? 0x00 : PAGE_UNKNOWN;
             }
 
             void setWaveformOrderAndID(uint8_t order, uint8_t id)
@@ -100,206 +204,563 @@ namespace EmbeddedDevices
                 // if id == 0, stop playing
                 // else continue to play until the it reaches to id == 7
 
-                if (order > 8) return;
-                waveform_ids[order] = id;
-                for (uint8_t i = 0; i < 8; ++i)
-                    write(0x03 + i, waveform_ids[i]);
+                if (order >= SEQUENCE_SIZE) return;
+                setField(SEQUENCE_REG + order, 0xFF, id);
             }
 
-            void setMemoryPage(uint8_t page)
+            uint8_t getWaveformID(uint8_t order) const { return (order < SEQUENCE_SIZE) ? regs_[SEQUENCE_REG + order] : 0; }
+
+            // whole playback sequence at once : only the slots which differ from the chip are written,
+            // as a single burst from the first to the last changed slot
+            void setSequence(const Sequence& seq)
             {
-                write(0xFF, page);
+                uint8_t first = SEQUENCE_SIZE, last = 0;
+                for (uint8_t i = 0; i < SEQUENCE_SIZE; ++i)
+                {
+                    const uint8_t reg = SEQUENCE_REG + i;
+                    if (regs_[reg] == seq.ids[i] && (valid_ & (1 << reg)) && !(dirty_ & (1 << reg))) continue;
+                    if (first == SEQUENCE_SIZE) first = i;
+                    last = i;
+                }
+                if (first == SEQUENCE_SIZE) return;
+
+                for (uint8_t i = first; i <= last; ++i) regs_[SEQUENCE_REG + i] = seq.ids[i];
+                setMemoryPage(0x00);
+                write(SEQUENCE_REG + first, regs_ + SEQUENCE_REG + first, last - first + 1);
+
+                const uint16_t bits = (uint16_t)(((1UL << (SEQUENCE_REG + last + 1)) - 1) & ~((1UL << (SEQUENCE_REG + first)) - 1));
+                dirty_ &= ~bits;
+                if (status_ == 0) valid_ |= bits;
+                else              valid_ &= ~bits;
             }
 
-#ifndef __AVR__
-            void setRepeat(uint8_t i, uint8_t r)
+            // swap in a precomputed sequence right before triggering it
+            void play(const Sequence& seq)
             {
-                effects.setRepeat(i, r);
+                standby(false);
+                setSequence(seq);
+                go();
             }
-#endif
 
-#ifdef __AVR__
+            // register shadow : setters above only write registers whose value changes
+            // between beginUpdate() and commit() changes are collected and written in one burst
 
-            void addSynthesizer(const SynthChunk* synthparams, const uint8_t size_of_synth)
+            void beginUpdate() { ++transaction_; }
+            void commit()
             {
-                const uint8_t SYNTH_PARAMS_BYTES = 4;
-                const uint8_t SYNTH_HEADER_BYTES = 5;
-                const uint8_t SYNTH_MODE_BITS = 0x80;
-                setMemoryPage(0x01); // go to RAM
+                if (transaction_ && --transaction_) return;
+                flushRegisters();
+            }
 
-                Serial.println("write header size");
+            // cached value of a control register (0x00 - 0x0B)
+            uint8_t getRegister(const uint8_t reg) const { return regs_[reg]; }
 
-                // header size
-                uint8_t header_size = 5; // for one sequence....
-                write(0x00, header_size);
+            // forget cached state, e.g. after the chip was power cycled
+            void invalidateRegisters()
+            {
+                valid_ = 0;
+                page_ = PAGE_UNKNOWN;
+            }
 
-                Serial.println("write waveform");
+            // adopt cached register / page state of another driver whose chip received the same writes
+            // (e.g. broadcast through an I2C mux with several channels enabled)
+            void copyStateFrom(const DRV2667& other)
+            {
+                for (uint8_t i = 0; i < NUM_REGS; ++i) regs_[i] = other.regs_[i];
+                valid_ = other.valid_;
+                dirty_ = other.dirty_;
+                page_ = other.page_;
+            }
+            bool hasSameState(const DRV2667& other) const
+            {
+                if (page_ != other.page_ || valid_ != other.valid_ || dirty_ || other.dirty_) return false;
+                for (uint8_t i = 0; i < NUM_REGS; ++i)
+                    if ((valid_ & (1 << i)) && regs_[i] != other.regs_[i]) return false;
+                return true;
+            }
 
-                for (uint8_t i = 0; i < size_of_synth; ++i)
-                {
-                    uint16_t start_addr = (uint16_t)header_size + 1 + 4 * i;
+            // control registers 0x01 - 0x0A which differ from the cache (bit n : register n), one burst read
+            // GO and DEV_RST are ignored, matching registers become valid; 0xFFFF if they could not be read
+            uint16_t verifyRegisters()
+            {
+                uint8_t chip[NUM_REGS];
+                setMemoryPage(0x00);
+                if (read(0x01, chip + 1, SEQUENCE_REG + SEQUENCE_SIZE - 1) != SEQUENCE_REG + SEQUENCE_SIZE - 1) return 0xFFFF;
+                chip[0x02] &= ~((1 << 7) | 0x01);
+                uint16_t diff = 0;
+                for (uint8_t i = 0x01; i < SEQUENCE_REG + SEQUENCE_SIZE; ++i)
+                    if (chip[i] != regs_[i]) diff |= (1 << i);
+                valid_ = (valid_ | REG_WRITABLE) & ~diff;
+                return diff;
+            }
+            // write the cached value of registers in mask again
+            void restoreRegisters(const uint16_t mask)
+            {
+                dirty_ |= (mask & REG_WRITABLE);
+                if (!transaction_) flushRegisters();
+            }
 
-                    if (i == 0)
+            // burst write to control registers from reg, bypassing the setters : the cache follows what was
+            // written (registers become unknown if the write failed, all of them after DEV_RST)
+            void writeRegisters(const uint8_t reg, const uint8_t* data, const uint16_t size)
+            {
+                setMemoryPage(0x00);
+                write(reg, data, size);
+                bool reset = false;
+                for (uint16_t i = 0; i < size && reg + i < NUM_REGS; ++i)
+                {
+                    const uint8_t r = uint8_t(reg + i);
+                    const uint16_t bit = (1 << r);
+                    if (!(REG_WRITABLE & bit)) continue;
+                    regs_[r] = data[i];
+                    if (r == 0x02)
                     {
-                        setMemoryPage(0x01); // go to RAM
-
-                Serial.println("write waveform header");
-
-                        // header
-                        uint8_t start_addr_h = (uint8_t)((start_addr >> 8) & 0x03);
-                        uint8_t start_addr_l = (uint8_t)(start_addr & 0x00FF);
-                        write(0x01 + SYNTH_HEADER_BYTES * i, start_addr_h + SYNTH_MODE_BITS);
-                        write(0x02 + SYNTH_HEADER_BYTES * i, start_addr_l);
-                        write(0x03 + SYNTH_HEADER_BYTES * i, start_addr_h); // TODO:
-                        write(0x04 + SYNTH_HEADER_BYTES * i, start_addr_l + SYNTH_PARAMS_BYTES * size_of_synth - 1);
-                        write(0x05 + SYNTH_HEADER_BYTES * i, 1); // 0x00 means repeat endlessly
+                        reset = (data[i] & (1 << 7));
+                        regs_[r] &= ~((1 << 7) | 0x01); // self-clearing bits
                     }
+                    dirty_ &= ~bit;
+                    if (status_ == 0) valid_ |= bit;
+                    else              valid_ &= ~bit;
+                }
+                if (reset) invalidateRegisters();
+            }
 
-                Serial.print("write waveform data ");
-                Serial.println(i);
+            // a transaction failed since the last clearFault() (the chip may differ from the cache)
+            bool hasFault() const { return fault_; }
+            void clearFault() { fault_ = false; }
 
-                    // synthesizer parameters
-                    write(start_addr + 0, synthparams[i].amp);
-                    write(start_addr + 1, synthparams[i].freq);
-                    write(start_addr + 2, synthparams[i].cycle);
-                    write(start_addr + 3, synthparams[i].envelop);
+            // reload cache from the chip
+            void syncRegisters()
+            {
+                const uint16_t page = read(0xFF);
+                page_ = (status_ == 0) ? uint8_t(page) : PAGE_UNKNOWN;
+                setMemoryPage(0x00);
+                uint8_t chip[NUM_REGS];
+                const uint16_t received = read(0x00, chip, NUM_REGS); // one burst
+                for (uint8_t i = 0; i < received; ++i)
+                {
+                    regs_[i] = chip[i];
+                    valid_ |= (1 << i);
                 }
+                regs_[0x02] &= ~((1 << 7) | 0x01); // self-clearing bits
+                dirty_ = 0;
+            }
 
-                Serial.println("return to control space");
+            // 0x00 : control registers, 0x01 - 0x08 : RAM
+            // the selected page is cached; the register is only written when it changes
+            void setMemoryPage(uint8_t page)
+            {
+                if (page == page_) return;
+                write(PAGE_REG, page);
+                page_ = (status_ == 0) ? page : PAGE_UNKNOWN;
+            }
+            uint8_t getMemoryPage() const { return page_; }
 
-                setMemoryPage(0x00); // back to register control space
+            void setRepeat(uint8_t i, uint8_t r)
+            {
+                if (effects_) effects_->setRepeat(i, r);
             }
 
-#else
+            // false if the effect does not fit into RAM (see Effects::freeBytes()) or there is no store
+            bool addWaveform(const uint8_t* const data, const uint16_t size)
+            {
+                if (!effects_ || !effects_->append(data, size)) return false;
+                syncEffects();
+                return true;
+            }
 
-            // TODO: support multiple synth effects
-            // TODO: vector support...
+            template <typename Storage>
+            bool addSynthesizer(const BasicSynthesizer<Storage>& synth)
+            {
+                if (!effects_ || !effects_->append(synth)) return false;
+                syncEffects();
+                return true;
+            }
+            bool addSynthesizer(const Chunk* const chunks, const uint16_t size, const uint8_t repeat = 1)
+            {
+                if (!effects_ || !effects_->append(chunks, size, repeat)) return false;
+                syncEffects();
+                return true;
+            }
 
-            void addWaveform(const uint8_t* const data, const uint16_t size)
+            // upload whole effects image regardless of what the chip holds
+            void setEffects()
             {
-                effects.append(data, size);
-                setEffects();
+                if (!effects_) return;
+                effects_->invalidate();
+                syncEffects();
             }
 
-            void addSynthesizer(const Synthesizer& synth)
+            // upload only the ranges of the effects image changed since last sync
+            // a shared store stays dirty : the other devices still need the ranges (see DeviceArray::syncEffects())
+            void syncEffects()
             {
-                effects.append(synth);
-                setEffects();
+                if (!effects_ || !effects_->isDirty()) return;
+
+                for (uint8_t i = 0; i < effects_->dirtySpans(); ++i)
+                {
+                    const Span& span = effects_->dirtySpan(i);
+                    writeRAM(span.begin, effects_->image() + span.begin, span.end - span.begin);
+                }
+                if (!shared_) effects_->clearDirty();
+                if (pending_)
+                {
+                    latency_us_ = micros() - pending_since_us_;
+                    pending_ = false;
+                }
             }
 
-            void setEffects()
+            // with DRV2667_EMBED_EFFECTS 0, call useEffects() before getEffects()
+            Effects& getEffects() { return *effects_; }
+            const Effects& getEffects() const { return *effects_; }
+            bool hasEffects() const { return effects_ != nullptr; }
+
+            // work on a store owned elsewhere, e.g. one library shared by several devices (see DeviceArray)
+            // the chip is not written : call setEffects() to upload the whole store
+            // shared : other devices use the store too, so syncs of this driver leave it dirty for them
+            void useEffects(Effects& store, const bool shared = false)
             {
-                if (effects.isMaxSize()) return;
+                effects_ = &store;
+                shared_ = shared;
+            }
+            bool sharesEffects() const { return shared_; }
 
-                setMemoryPage(0x01); // go to RAM
+            // live modulation : changes are coalesced in the effects image until flush()
+            // flush once per frame to send all of them as a minimal set of bursts
 
-                // 0x000 : header size
-                write(0x00, effects.getHeaderSize());
+            void amp(uint8_t i, uint8_t j, uint8_t v) { if (!effects_) return; const Edit e = edit(); effects_->amp(i, j, v); touch(e); }
+            void freq(uint8_t i, uint8_t j, uint8_t v) { if (!effects_) return; const Edit e = edit(); effects_->freq(i, j, v); touch(e); }
+            void cycle(uint8_t i, uint8_t j, uint8_t v) { if (!effects_) return; const Edit e = edit(); effects_->cycle(i, j, v); touch(e); }
+            void envelop(uint8_t i, uint8_t j, uint8_t v) { if (!effects_) return; const Edit e = edit(); effects_->envelop(i, j, v); touch(e); }
 
-                // 0x001- : headers
-                for (uint8_t i = 0; i < effects.size(); ++i)
+            void flush()
+            {
+                if (!effects_) return;
+                if (!effects_->isDirty())
+                {
+                    pending_ = false; // written by someone else (e.g. TransactionQueue), nothing to measure
+                    return;
+                }
+                syncEffects();
+            }
+
+            // micros from the first modification to the end of the flush which wrote it to RAM
+            uint32_t getUpdateLatency() const { return latency_us_; }
+
+            void write(const uint8_t reg, const uint8_t data, bool stop = true)
+            {
+                transmit(reg, &data, 1, stop);
+            }
+
+            // burst write with register auto-increment, split into transactions of burst size
+            void write(const uint8_t reg, const uint8_t* data, const uint16_t size)
+            {
+                uint16_t offset = 0;
+                while (offset < size)
+                {
+                    uint16_t n = size - offset;
+                    if (n > burst_size) n = burst_size;
+                    transmit(uint8_t(reg + offset), data + offset, n);
+                    offset += n;
+                }
+            }
+
+            // samples to the playback FIFO : address does not auto-increment on FIFO writes
+            void writeFIFO(const uint8_t* data, const uint16_t size)
+            {
+                setMemoryPage(0x00);
+
+                uint16_t offset = 0;
+                while (offset < size)
+                {
+                    uint16_t n = size - offset;
+                    if (n > burst_size) n = burst_size;
+                    transmit(FIFO_REG, data + offset, n);
+                    offset += n;
+                }
+            }
+
+            // write to linear RAM address (0x000 - 0x7FF), switching page at 256 byte boundaries
+            // offset 0xFF of every page is the page register : that byte is skipped, never written
+            // memory page is left in RAM space; register setters of this class switch back when needed
+            void writeRAM(const uint16_t addr, const uint8_t* data, const uint16_t size)
+            {
+                uint16_t offset = 0;
+                while (offset < size)
                 {
-                    write(effects.getHeaderAddrStart(i) + 0x00, effects.getEffectAddrStartH(i));
-                    write(effects.getHeaderAddrStart(i) + 0x01, effects.getEffectAddrStartL(i));
-                    write(effects.getHeaderAddrStart(i) + 0x02, effects.getEffectAddrStopH(i));
-                    write(effects.getHeaderAddrStart(i) + 0x03, effects.getEffectAddrStopL(i));
-                    write(effects.getHeaderAddrStart(i) + 0x04, effects.getRepeatCount(i)); // 0x00 means repeat endlessly
+                    const uint16_t a = addr + offset;
+                    if (a % RAM_PAGE_BYTES == PAGE_REG)
+                    {
+                        ++offset;
+                        continue;
+                    }
+                    uint16_t n = PAGE_REG - (a % RAM_PAGE_BYTES);
+                    if (n > size - offset) n = size - offset;
+                    setMemoryPage(uint8_t(0x01 + (a / RAM_PAGE_BYTES)));
+                    write(uint8_t(a % RAM_PAGE_BYTES), data + offset, n);
+                    offset += n;
                 }
+            }
 
-                // effects
-                for (uint8_t i = 0; i < effects.size(); ++i)
+            // burst read of linear RAM address (0x000 - 0x7FF), returns number of bytes covered
+            // offset 0xFF of every page is the page register : data at those offsets is left untouched
+            uint16_t readRAM(const uint16_t addr, uint8_t* data, const uint16_t size)
+            {
+                uint16_t offset = 0;
+                while (offset < size)
                 {
-                    setMemoryPage(effects.getEffectStartPage(i));
-                    switch (effects.getPlayMode(i))
+                    const uint16_t a = addr + offset;
+                    if (a % RAM_PAGE_BYTES == PAGE_REG)
                     {
-                        case PlayMode::Direct:
-                        {
-                            for (size_t j = 0; j < effects.size(i); ++i)
-                                write(effects.getEffectAddrStartL(i), effects.data(i, j));
-                            break;
-                        }
-                        case PlayMode::Synthesis:
-                        {
-                            for (size_t j = 0; j < effects.size(i); ++j)
-                            {
-                                write(effects.getEffectAddrChunk(i, j) + 0x00, effects.amp(i, j));
-                                write(effects.getEffectAddrChunk(i, j) + 0x01, effects.freq(i, j));
-                                write(effects.getEffectAddrChunk(i, j) + 0x02, effects.cycle(i, j));
-                                write(effects.getEffectAddrChunk(i, j) + 0x03, effects.envelop(i, j));
-                            }
-                            break;
-                        }
+                        ++offset;
+                        continue;
                     }
+                    uint16_t n = PAGE_REG - (a % RAM_PAGE_BYTES);
+                    if (n > size - offset) n = size - offset;
+                    setMemoryPage(uint8_t(0x01 + (a / RAM_PAGE_BYTES)));
+                    const uint16_t received = read(uint8_t(a % RAM_PAGE_BYTES), data + offset, n);
+                    offset += received;
+                    if (received < n) break;
                 }
-                setMemoryPage(0x00); // back to register control space
+                return offset;
             }
 
-            void amp(uint8_t i, uint8_t j, uint8_t v)
+            // upload a prebuilt RAM image (e.g. makeRamImage()) as is, starting from address 0x000
+            // effects added with addWaveform() / addSynthesizer() are overwritten on the chip
+            void upload(const uint8_t* image, const uint16_t size)
             {
-                effects.amp(i, j, v);
-                setMemoryPage(0x01); // go to RAM
-                write(effects.getEffectAddrChunk(i, j) + 0x00, v);
-                setMemoryPage(0x00); // back to register control space
-                // setEffects();
+                writeRAM(0x000, image, size);
             }
-#endif
+            template <typename Image>
+            void upload(const Image& image) { upload(image.data(), image.size()); }
 
-            void write(const uint8_t reg, const uint8_t data, bool stop = true)
+            // data bytes per transaction (register address byte excluded)
+            void setBurstSize(const uint8_t size)
             {
-                wire->beginTransmission(I2C_ADDR);
-                wire->write(reg);
-                wire->write(data);
-                status_ = wire->endTransmission(stop);
+                const uint8_t max_size = DRV2667_I2C_BUFFER_LENGTH - 1;
+                burst_size = (size == 0) ? 1 : ((size > max_size) ? max_size : size);
+            }
+            uint8_t getBurstSize() const { return burst_size; }
 
-                if (status_ != 0)
+            uint16_t read(const uint8_t reg)
+            {
+                uint8_t data;
+                if (receive(reg, &data, 1) == 1) return data;
+                return 0xFF;
+            }
+
+            // burst read with register auto-increment, returns number of bytes read
+            uint16_t read(const uint8_t reg, uint8_t* data, const uint16_t size)
+            {
+                uint16_t offset = 0;
+                while (offset < size)
                 {
-                    Serial.print("I2C error : ");
-                    Serial.println(status_);
+                    uint16_t n = size - offset;
+                    if (n > DRV2667_I2C_BUFFER_LENGTH) n = DRV2667_I2C_BUFFER_LENGTH;
+                    const uint8_t received = receive(uint8_t(reg + offset), data + offset, n);
+                    offset += received;
+                    if (received < n) break;
                 }
+                return offset;
             }
 
-            uint16_t read(const uint8_t reg)
+            // failed transactions are retried up to n times before reporting an error
+            void setRetry(const uint8_t n) { retry_ = n; }
+
+            // called for every failed transaction (after retries) instead of printing to Serial
+            // keep it short and non-blocking : it runs inside write() / read()
+            void setErrorSink(ErrorSink sink, void* context = nullptr)
             {
-                // write(reg, false);
-                wire->beginTransmission(I2C_ADDR);
-                wire->write(reg);
-                status_ = wire->endTransmission(false);
+                error_sink_ = sink;
+                error_context_ = context;
+            }
+
+#if DRV2667_ENABLE_STATS
+            const Stats& getStats() const { return stats_; }
+            void resetStats() { stats_ = Stats(); }
+#endif
+
+        private:
 
+            uint8_t transmit(const uint8_t reg, const uint8_t* data, const uint8_t size, const bool stop = true)
+            {
+                uint8_t tries = 0;
+                while (true)
+                {
+#if DRV2667_ENABLE_STATS
+                    const uint32_t begin_us = micros();
+#endif
+                    wire->beginTransmission(addr_);
+                    wire->write(reg);
+                    for (uint8_t i = 0; i < size; ++i) wire->write(data[i]);
+                    status_ = wire->endTransmission(stop);
+#if DRV2667_ENABLE_STATS
+                    stats_.record(micros() - begin_us, status_);
+                    if (status_ == 0 && size > 0)
+                    {
+                        stats_.bytes_written += size;
+                        if (reg == PAGE_REG)        ++stats_.page_writes;
+                        else if (page_ != 0x00)     ++stats_.ram_writes;
+                        else if (reg < Stats::NUM_REGS) ++stats_.reg_writes[reg];
+                    }
+#endif
+                    if (status_ == 0 || tries >= retry_) break;
+                    ++tries;
+#if DRV2667_ENABLE_STATS
+                    ++stats_.retries;
+#endif
+                }
                 if (status_ != 0)
                 {
-                    Serial.print("I2C error : ");
-                    Serial.println(status_);
+                    fault_ = true;
+                    if (error_sink_) error_sink_(reg, status_, error_context_);
                 }
+                return status_;
+            }
 
-                if (wire->requestFrom((uint8_t)I2C_ADDR, (uint8_t)1))
-                    return wire->read();
+            uint8_t receive(const uint8_t reg, uint8_t* data, const uint8_t size)
+            {
+                if (transmit(reg, nullptr, 0, false) != 0) return 0;
 
-                return 0xFF;
+#if DRV2667_ENABLE_STATS
+                const uint32_t begin_us = micros();
+#endif
+                const uint8_t received = wire->requestFrom(addr_, size);
+                for (uint8_t i = 0; i < received; ++i) data[i] = wire->read();
+#if DRV2667_ENABLE_STATS
+                stats_.record(micros() - begin_us, (received == size) ? 0 : 4);
+                stats_.bytes_read += received;
+                ++stats_.reads;
+#endif
+                if (received != size)
+                {
+                    status_ = 4; // as endTransmission() "other error" : a short read fails the caller
+                    fault_ = true;
+                    if (error_sink_) error_sink_(reg, status_, error_context_);
+                }
+                return received;
             }
 
-        private:
+            static const uint8_t PAGE_UNKNOWN = 0xFF;
+            static const uint8_t NUM_REGS = 0x0C;
+            static const uint16_t REG_WRITABLE = 0x07FE; // 0x01 - 0x0A (0x00 is status, 0x0B is FIFO)
+
+            void setField(const uint8_t reg, const uint8_t mask, const uint8_t bits)
+            {
+                const uint8_t v = (regs_[reg] & ~mask) | (bits & mask);
+                if (v == regs_[reg] && (valid_ & (1 << reg))) return;
+                regs_[reg] = v;
+                dirty_ |= (1 << reg);
+                if (!transaction_) flushRegisters();
+            }
+
+            // write each run of consecutive dirty registers as one burst
+            void flushRegisters()
+            {
+                if (!dirty_) return;
+                setMemoryPage(0x00);
+                uint8_t reg = 0;
+                while (reg < NUM_REGS)
+                {
+                    if (!(dirty_ & (1 << reg))) { ++reg; continue; }
+                    uint8_t end = reg;
+                    while (end < NUM_REGS && (dirty_ & (1 << end))) ++end;
+                    write(reg, regs_ + reg, end - reg);
+                    const uint16_t bits = (uint16_t)(((1UL << end) - 1) & ~((1UL << reg) - 1));
+                    dirty_ &= ~bits;
+                    if (status_ == 0) valid_ |= bits;
+                    else              valid_ &= ~bits;
+                    reg = end;
+                }
+            }
+
+            // effects state before a modulation
+            struct Edit
+            {
+                uint16_t edits;
+                bool clean;
+            };
+            Edit edit() const { return Edit {effects_->edits(), !effects_->isDirty()}; }
+
+            // latency starts with the first byte marked dirty; an image found clean means an earlier
+            // pending change has been written meanwhile, so its timestamp is stale
+            void touch(const Edit& e)
+            {
+                if (effects_->edits() == e.edits) return; // value unchanged, nothing to upload
+                if (pending_ && !e.clean) return;
+                pending_ = true;
+                pending_since_us_ = micros();
+            }
 
             TwoWire* wire;
+            uint8_t addr_ {I2C_ADDR};
 
-#ifndef __AVR__
-            Effects effects;
+#if DRV2667_EMBED_EFFECTS
+            Effects own_effects_;
+            Effects* effects_ {&own_effects_};
+#else
+            Effects* effects_ {nullptr}; // set by useEffects()
 #endif
+            bool shared_ {false};
 
-            uint8_t reg_01 {0x38};
-            uint8_t reg_02 {0x40};
+            uint8_t regs_[NUM_REGS] {0x00, 0x38, 0x40};
+            uint16_t valid_ {0}; // bit n : regs_[n] is known to match the chip
+            uint16_t dirty_ {0}; // bit n : regs_[n] waits for commit
+            uint8_t transaction_ {0};
 
-            uint8_t waveform_ids[8] {0};
             uint8_t status_;
+            bool fault_ {false};
+            uint8_t retry_ {0};
+            ErrorSink error_sink_ {nullptr};
+            void* error_context_ {nullptr};
+#if DRV2667_ENABLE_STATS
+            Stats stats_ {};
+#endif
+            uint8_t burst_size {DRV2667_I2C_BUFFER_LENGTH - 1};
+            uint8_t page_ {PAGE_UNKNOWN};
+
+            bool pending_ {false};
+            uint32_t pending_since_us_ {0};
+            uint32_t latency_us_ {0};
         };
     }
 }
 
+#include "DRV2667/FifoStream.h"
+#include "DRV2667/AnalogStream.h"
+#include "DRV2667/Renderer.h"
+#include "DRV2667/Scheduler.h"
+#include "DRV2667/EffectCache.h"
+#include "DRV2667/EffectPack.h"
+#include "DRV2667/Recovery.h"
+#include "DRV2667/TransactionQueue.h"
+#include "DRV2667/DeviceArray.h"
+
 using DRV2667 = EmbeddedDevices::DRV2667::DRV2667;
-#ifdef __AVR__
+using DRV2667Sequence = EmbeddedDevices::DRV2667::Sequence;
+using DRV2667Chunk = EmbeddedDevices::DRV2667::Chunk;
+using DRV2667EffectStore = EmbeddedDevices::DRV2667::Effects;
+// earlier AVR name of the synthesizer chunk type, kept with that meaning (same as DRV2667Chunk)
 using DRV2667Effects = EmbeddedDevices::DRV2667::SynthChunk;
-#else
 using DRV2667Synthesizer = EmbeddedDevices::DRV2667::Synthesizer;
 using DRV2667Waveform = EmbeddedDevices::DRV2667::Waveform;
+using DRV2667Scheduler = EmbeddedDevices::DRV2667::Scheduler;
+#if DRV2667_USE_HEAP
+template <typename Key = uint16_t>
+using DRV2667EffectCache = EmbeddedDevices::DRV2667::EffectCache<Key>;
 #endif
+template <uint16_t N = 1024>
+using DRV2667FifoStream = EmbeddedDevices::DRV2667::FifoStream<N>;
+template <uint16_t N = 128>
+using DRV2667AnalogStream = EmbeddedDevices::DRV2667::AnalogStream<N>;
+using DRV2667AnalogTable = EmbeddedDevices::DRV2667::AnalogTable;
+using DRV2667Renderer = EmbeddedDevices::DRV2667::Renderer;
+using DRV2667EffectPack = EmbeddedDevices::DRV2667::EffectPack;
+using DRV2667Recovery = EmbeddedDevices::DRV2667::Recovery;
+template <uint8_t N = 16>
+using DRV2667TransactionQueue = EmbeddedDevices::DRV2667::TransactionQueue<N>;
+template <uint8_t N = 8>
+using DRV2667Array = EmbeddedDevices::DRV2667::DeviceArray<N>;
+using DRV2667Mux = EmbeddedDevices::DRV2667::Mux;
 
 #endif // DRV2667_H
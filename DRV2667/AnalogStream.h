@@ -0,0 +1,202 @@
+#pragma once
+#ifndef DRV2667_ANALOGSTREAM_H
+#define DRV2667_ANALOGSTREAM_H
+
+#include <math.h>
+
+        // Analog input playback : with the input mux on IN+/IN-, the chip amplifies an external drive signal
+        // (e.g. from a DAC). AnalogStream generates that signal from precomputed one-period tables into two
+        // buffers of N samples : the sample clock (a timer interrupt calling tick(), or a circular DMA transfer
+        // calling transferred() at half and full completion) plays one buffer while service() refills the other
+        // from loop(). The output never depends on loop() timing, as long as service() runs once per buffer.
+        // Tone, level and gain() change at buffer boundaries : a new gain is tagged to the buffer filled with
+        // the samples following it and written by the first service() after that buffer started playing.
+        // I2C is only used from service(), never from the interrupt.
+        //
+        // samples are unsigned DAC codes, 128 is silence
+
+namespace EmbeddedDevices
+{
+    namespace DRV2667
+    {
+        struct AnalogStats
+        {
+            uint32_t buffers;       // buffers played
+            uint32_t underruns;     // buffers replayed because service() was late
+            uint32_t gain_switches; // gain() writes at buffer boundaries
+        };
+
+        // one period of a drive waveform
+        struct AnalogTable
+        {
+            const uint8_t* samples;
+            uint16_t size;
+        };
+
+        inline void makeSineTable(uint8_t* table, const uint16_t size)
+        {
+            for (uint16_t i = 0; i < size; ++i)
+                table[i] = uint8_t(128.5f + 127.f * sinf(6.2831853f * i / size));
+        }
+        inline void makeSquareTable(uint8_t* table, const uint16_t size)
+        {
+            for (uint16_t i = 0; i < size; ++i) table[i] = (i < size / 2) ? 255 : 1;
+        }
+
+        template <uint16_t N = 128>
+        class AnalogStream
+        {
+        public:
+
+            static const uint8_t SILENCE = 128;
+            static const uint16_t BUFFER_SIZE = N;
+
+            AnalogStream(DRV2667& drv, const uint32_t rate_hz) : drv_(drv), rate_(rate_hz) {}
+
+            // analog input, boost on; both buffers are filled before the sample clock starts
+            void begin()
+            {
+                drv_.setToAnalogInput();
+                playing_ = 0;
+                pos_ = 0;
+                fill(buf_[0]);
+                ready_[0] = 1;
+                ready_[1] = 0;
+                service();
+            }
+
+            // table has to stay valid while it is played; applied from the next buffer on
+            // hz is limited to half the sample rate
+            void play(const AnalogTable& table, const float hz, const uint8_t level = 255)
+            {
+                const float nyquist = rate_ / 2.f;
+                const float f = (hz <= 0.f) ? 0.f : ((hz < nyquist) ? hz : nyquist);
+                table_ = table;
+                step_ = uint32_t(f / rate_ * 4294967296.);
+                level_ = level;
+            }
+            void setLevel(const uint8_t level) { level_ = level; }
+            void stop() { level_ = 0; }
+
+            // switched together with the next buffer filled by service()
+            void gain(const DRV2667::Gain g)
+            {
+                gain_ = g;
+                gain_pending_ = true;
+            }
+
+            // interrupt side
+
+            // timer : one sample per tick
+            uint8_t tick()
+            {
+                const uint8_t v = buf_[playing_][pos_];
+                if (++pos_ == N)
+                {
+                    pos_ = 0;
+                    swap();
+                }
+                return v;
+            }
+            // DMA : circular transfer of the 2 x N samples from data(), call at half and full completion
+            const uint8_t* data() const { return buf_[0]; }
+            void transferred() { swap(); }
+
+            // main side : call from loop() at least every N / rate s, returns true if a buffer was refilled
+            bool service()
+            {
+                if (gain_started_ != gain_seen_) // the tagged buffer is playing
+                {
+                    gain_seen_ = gain_started_;
+                    gain_buffer_ = NO_BUFFER;
+                    drv_.gain(gain_next_);
+                    ++stats_.gain_switches;
+                }
+
+                // only the buffer played next : after an underrun the playing one replays stale samples,
+                // refilling it would change samples under the interrupt
+                const uint8_t b = playing_ ^ 1;
+                if (ready_[b]) return false;
+                if (gain_pending_)
+                {
+                    gain_pending_ = false;
+                    gain_next_ = gain_;
+                    gain_buffer_ = b;
+                }
+                fill(buf_[b]);
+                ready_[b] = 1;
+                return true;
+            }
+
+            // buffers and underruns are counted by the interrupt : copied and reset with interrupts masked
+            AnalogStats stats() const
+            {
+                noInterrupts();
+                const AnalogStats s = stats_;
+                interrupts();
+                return s;
+            }
+            void resetStats()
+            {
+                noInterrupts();
+                stats_ = AnalogStats();
+                interrupts();
+            }
+
+        private:
+
+            // buffer done : hand it back to service() and continue with the other one
+            void swap()
+            {
+                ready_[playing_] = 0;
+                playing_ ^= 1;
+                ++stats_.buffers;
+                if (!ready_[playing_]) ++stats_.underruns; // replays stale samples rather than stopping
+                if (playing_ == gain_buffer_) ++gain_started_;
+            }
+
+            void fill(uint8_t* out)
+            {
+                const uint8_t level = level_;
+                for (uint16_t i = 0; i < N; ++i)
+                {
+                    if (!table_.size || level == 0)
+                    {
+                        out[i] = SILENCE;
+                        continue;
+                    }
+                    const uint16_t k = uint16_t(((phase_ >> 16) * table_.size) >> 16);
+                    const int16_t v = int16_t(table_.samples[k]) - SILENCE;
+                    out[i] = uint8_t(SILENCE + v * level / 255);
+                    phase_ += step_;
+                }
+            }
+
+            DRV2667& drv_;
+            const uint32_t rate_;
+
+            uint8_t buf_[2][N];
+            // written by one side each : single byte flags, no lock needed
+            volatile uint8_t playing_ {0};     // interrupt
+            volatile uint8_t ready_[2] {0, 0}; // set by service(), cleared by the interrupt
+            uint16_t pos_ {0};
+
+            AnalogTable table_ {nullptr, 0};
+            uint32_t phase_ {0};
+            uint32_t step_ {0};
+            uint8_t level_ {255};
+
+            static const uint8_t NO_BUFFER = 0xFF;
+            DRV2667::Gain gain_ {DRV2667::Gain::D25V_A288dB};
+            DRV2667::Gain gain_next_ {DRV2667::Gain::D25V_A288dB};
+            bool gain_pending_ {false};
+            volatile uint8_t gain_buffer_ {NO_BUFFER}; // set by service() : buffer the new gain belongs to
+            volatile uint8_t gain_started_ {0};        // interrupt : counts swaps to that buffer
+            uint8_t gain_seen_ {0};
+
+            AnalogStats stats_ {};
+        };
+    }
+}
+
+#endif // DRV2667_ANALOGSTREAM_H
@@ -0,0 +1,448 @@
+#pragma once
+#ifndef DRV2667_COMPILER_H
+#define DRV2667_COMPILER_H
+
+// Offline waveform compiler (host / non-AVR) : fits PCM or an amplitude / frequency envelope to
+// the most compact DRV2667 representation. Runs of coherent sinusoidal cycles become synthesizer
+// chunks (4 bytes for up to 255 cycles), everything else is kept as 8 kHz direct samples.
+// The result is emitted as a C++ header usable with Effects / DRV2667::addSynthesizer().
+// see extras/compiler for the command line tool
+
+#ifndef __AVR__
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <iterator>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include "Effect.h"
+
+namespace EmbeddedDevices
+{
+    namespace DRV2667
+    {
+        namespace compiler
+        {
+            static const uint16_t RAM_SIZE = 2048;
+            static const uint8_t HEADER_BYTES = 5;
+            // one effect stays within a RAM page, off its page register at 0xFF
+            static const uint8_t MAX_SEGMENT_BYTES = 0xFF;
+            static const uint8_t MAX_SEGMENT_CHUNKS = MAX_SEGMENT_BYTES / 4;
+            static const uint8_t MAX_EFFECTS = 50;   // header table
+            static const uint8_t SEQUENCE_SLOTS = 8; // effects one go() plays
+            static constexpr float FREQ_STEP = 7.8125f; // Hz per frequency LSB
+
+            struct Options
+            {
+                float tolerance {0.2f};    // max normalized RMS error of a synthesized run
+                float silence {0.02f};     // |x| below this is silence
+                uint16_t budget {RAM_SIZE}; // RAM bytes available (header size byte and headers included)
+                uint8_t slots {SEQUENCE_SLOTS}; // effects available, 1 - 8 to play the result as one sequence
+            };
+
+            struct Segment
+            {
+                PlayMode mode;
+                std::vector<uint8_t> bytes; // 4 bytes per chunk, or 8 kHz samples
+                uint32_t samples;           // duration at 8 kHz
+                float error;                // normalized RMS error against the source
+            };
+
+            struct Program
+            {
+                std::vector<Segment> segments;
+                bool fits {true};
+
+                // RAM bytes when loaded alone, laid out by a dry run of Effects itself (header slots reserved
+                // in steps, payloads off the page registers); segments which do not fit count on top of the RAM
+                uint32_t bytes() const
+                {
+                    BasicEffects<MAX_EFFECTS, RAM_SIZE> effects;
+                    uint32_t over = 0;
+                    for (const auto& s : segments)
+                    {
+                        const bool ok = !over && ((s.mode == PlayMode::Synthesis)
+                            ? effects.append((const Chunk*)s.bytes.data(), uint16_t(s.bytes.size() / sizeof(Chunk)))
+                            : effects.append(s.bytes.data(), uint16_t(s.bytes.size())));
+                        if (!ok) over += HEADER_BYTES + s.bytes.size();
+                    }
+                    return over ? RAM_SIZE + over : effects.getImageSize();
+                }
+                uint32_t samples() const
+                {
+                    uint32_t n = 0;
+                    for (const auto& s : segments) n += s.samples;
+                    return n;
+                }
+                // fits the RAM budget, the header table and the effect slots of opt
+                bool fitsInto(const Options& opt) const
+                {
+                    const size_t slots = (opt.slots < MAX_EFFECTS) ? opt.slots : MAX_EFFECTS;
+                    return bytes() <= opt.budget && segments.size() <= slots;
+                }
+            };
+
+            // one breakpoint of an envelope, linear in amplitude between points, frequency held
+            struct EnvelopePoint
+            {
+                float ms;   // time from start
+                float amp;  // 0 - 1
+                float hz;   // sinusoid frequency
+            };
+
+            inline uint8_t toSample(const float v)
+            {
+                const float c = (v > 1.f) ? 1.f : ((v < -1.f) ? -1.f : v);
+                return (uint8_t)(int8_t)lroundf(c * 127.f);
+            }
+
+            // linear resampling to 8 kHz
+            inline std::vector<float> resample(const float* pcm, const size_t size, const uint32_t rate)
+            {
+                if (rate == SAMPLE_RATE) return std::vector<float>(pcm, pcm + size);
+                std::vector<float> out;
+                const double step = (double)rate / SAMPLE_RATE;
+                for (double t = 0.; t + 1. < size; t += step)
+                {
+                    const size_t i = (size_t)t;
+                    const double f = t - i;
+                    out.push_back((float)(pcm[i] * (1. - f) + pcm[i + 1] * f));
+                }
+                return out;
+            }
+
+            // 8 / 16 bit PCM .wav, channels mixed down, -1 - 1 at the file's sample rate (see resample())
+            inline bool readWav(const std::string& path, std::vector<float>& pcm, uint32_t& rate)
+            {
+                std::ifstream f(path, std::ios::binary);
+                const std::vector<uint8_t> b((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+                if (b.size() < 12 || memcmp(b.data(), "RIFF", 4) || memcmp(b.data() + 8, "WAVE", 4)) return false;
+                auto le = [&](const size_t p, const uint8_t n)
+                {
+                    uint32_t v = 0;
+                    for (uint8_t i = 0; i < n; ++i) v |= (uint32_t)b[p + i] << (8 * i);
+                    return v;
+                };
+
+                uint16_t channels = 0, bits = 0;
+                for (size_t p = 12; p + 8 <= b.size();)
+                {
+                    const uint32_t size = le(p + 4, 4);
+                    if (p + 8 + size > b.size()) return false;
+                    if (!memcmp(&b[p], "fmt ", 4) && size >= 16)
+                    {
+                        if (le(p + 8, 2) != 1) return false; // PCM only
+                        channels = (uint16_t)le(p + 10, 2);
+                        rate = le(p + 12, 4);
+                        bits = (uint16_t)le(p + 22, 2);
+                    }
+                    else if (!memcmp(&b[p], "data", 4))
+                    {
+                        if (!channels || (bits != 8 && bits != 16)) return false;
+                        const uint32_t frame = channels * bits / 8;
+                        for (uint32_t i = 0; i + frame <= size; i += frame)
+                        {
+                            float sum = 0.f;
+                            for (uint16_t c = 0; c < channels; ++c)
+                            {
+                                const size_t k = p + 8 + i + c * bits / 8;
+                                sum += (bits == 8) ? (b[k] - 128) / 128.f : (int16_t)le(k, 2) / 32768.f;
+                            }
+                            pcm.push_back(sum / channels);
+                        }
+                        return true;
+                    }
+                    p += 8 + size + (size & 1);
+                }
+                return false;
+            }
+
+            // .csv envelope : one breakpoint "ms, amp, Hz" per line, other lines are skipped
+            inline bool readEnvelope(const std::string& path, std::vector<EnvelopePoint>& env)
+            {
+                std::ifstream f(path);
+                std::string line;
+                while (std::getline(f, line))
+                {
+                    for (auto& c : line) if (c == ',') c = ' ';
+                    std::istringstream ss(line);
+                    EnvelopePoint p;
+                    if (ss >> p.ms >> p.amp >> p.hz) env.push_back(p);
+                }
+                return env.size() >= 2;
+            }
+
+            namespace detail
+            {
+                // duration in samples of `cycles` cycles at frequency byte `freq`
+                inline double chunkSamples(const uint8_t freq, const uint8_t cycles)
+                {
+                    return (double)cycles * SAMPLE_RATE / (FREQ_STEP * freq);
+                }
+
+                // best (freq, cycles) for a silent chunk of n samples
+                inline Chunk silence(const uint32_t n)
+                {
+                    Chunk best {0, 1, 1, 0};
+                    double err = 1e9;
+                    for (uint16_t c = 1; c <= 255; ++c)
+                    {
+                        const long f = lround((double)c * SAMPLE_RATE / (FREQ_STEP * n));
+                        if (f < 1 || f > 255) continue;
+                        const double e = fabs(chunkSamples((uint8_t)f, (uint8_t)c) - n);
+                        if (e < err) { err = e; best = Chunk {0, (uint8_t)f, (uint8_t)c, 0}; }
+                        if (err < 0.5) break;
+                    }
+                    return best;
+                }
+
+                inline float rmsError(const float* x, const size_t n, const Chunk& c)
+                {
+                    double e = 0., p = 0.;
+                    const double w = 2. * M_PI * FREQ_STEP * c.freq / SAMPLE_RATE;
+                    for (size_t i = 0; i < n; ++i)
+                    {
+                        const double m = c.amp / 255. * sin(w * i);
+                        e += (x[i] - m) * (x[i] - m);
+                        p += x[i] * x[i];
+                    }
+                    return (p > 0.) ? (float)sqrt(e / p) : 0.f;
+                }
+
+                // appends to the last segment of the same mode, a full segment (one RAM page) continues in a new one
+                inline void push(Program& prog, const PlayMode mode, const uint8_t* bytes, const size_t n, const uint32_t samples, const float error)
+                {
+                    const size_t limit = (mode == PlayMode::Synthesis) ? MAX_SEGMENT_CHUNKS * 4 : MAX_SEGMENT_BYTES;
+                    size_t done = 0;
+                    uint32_t samples_done = 0;
+                    while (done < n)
+                    {
+                        if (prog.segments.empty() || prog.segments.back().mode != mode || prog.segments.back().bytes.size() >= limit)
+                            prog.segments.push_back(Segment {mode, {}, 0, 0.f});
+                        Segment& s = prog.segments.back();
+                        const size_t m = (n - done < limit - s.bytes.size()) ? n - done : limit - s.bytes.size();
+                        const uint32_t part = (done + m == n) ? samples - samples_done : (uint32_t)((uint64_t)samples * m / n);
+                        const float total = (float)(s.samples + part);
+                        s.error = (total > 0.f) ? (s.error * s.samples + error * part) / total : 0.f;
+                        s.bytes.insert(s.bytes.end(), bytes + done, bytes + done + m);
+                        s.samples += part;
+                        done += m;
+                        samples_done += part;
+                    }
+                }
+
+                inline void pushChunk(Program& prog, const Chunk& c, const uint32_t samples, const float error)
+                {
+                    const uint8_t b[4] {c.amp, c.freq, c.cycle, c.envelop};
+                    push(prog, PlayMode::Synthesis, b, 4, samples, error);
+                }
+
+                inline Program compile(const float* x, const size_t size, const float tolerance, const float silence)
+                {
+                    Program prog;
+                    size_t i = 0;
+                    while (i < size)
+                    {
+                        // silence
+                        size_t j = i;
+                        while (j < size && fabsf(x[j]) < silence) ++j;
+                        if (j - i >= 32 || j == size)
+                        {
+                            uint32_t rest = (uint32_t)(j - i);
+                            while (rest)
+                            {
+                                const uint32_t n = (rest > 8000) ? 8000 : rest;
+                                pushChunk(prog, detail::silence(n), n, 0.f);
+                                rest -= n;
+                            }
+                            i = j;
+                            continue;
+                        }
+
+                        // run of cycles with similar period : rising zero crossings
+                        std::vector<size_t> zc;
+                        if (x[i] >= 0.f && (i == 0 || x[i - 1] < 0.f)) zc.push_back(i);
+                        for (size_t k = i + 1; k < size && zc.size() < 257; ++k)
+                            if (x[k - 1] < 0.f && x[k] >= 0.f) zc.push_back(k);
+
+                        bool synthesized = false;
+                        if (zc.size() >= 2 && zc.front() - i <= zc[1] - zc[0])
+                        {
+                            const double period = (double)(zc[1] - zc[0]);
+                            size_t cycles = 1;
+                            while (cycles + 1 < zc.size() && cycles < 255)
+                            {
+                                const double p = (double)(zc[cycles + 1] - zc[cycles]);
+                                if (fabs(p - period) > 0.1 * period + 1.) break;
+                                ++cycles;
+                            }
+
+                            // frequency quantization accumulates phase error : shorten the run until it fits
+                            for (; cycles >= 1 && !synthesized; cycles /= 2)
+                            {
+                                const size_t begin = zc.front();
+                                const size_t end = zc[cycles];
+                                const long f = lround((double)SAMPLE_RATE * cycles / (end - begin) / FREQ_STEP);
+                                if (f < 1 || f > 255) break;
+                                float peak = 0.f;
+                                for (size_t k = begin; k < end; ++k) peak = fmaxf(peak, fabsf(x[k]));
+                                const Chunk c {(uint8_t)fminf(255.f, roundf(peak * 255.f)), (uint8_t)f, (uint8_t)cycles, 0};
+                                const float e = rmsError(x + begin, end - begin, c);
+                                if (e > tolerance) continue;
+
+                                if (begin > i)
+                                {
+                                    std::vector<uint8_t> lead;
+                                    for (size_t k = i; k < begin; ++k) lead.push_back(toSample(x[k]));
+                                    push(prog, PlayMode::Direct, lead.data(), lead.size(), (uint32_t)lead.size(), 0.f);
+                                }
+                                pushChunk(prog, c, (uint32_t)(end - begin), e);
+                                i = end;
+                                synthesized = true;
+                            }
+                        }
+                        if (synthesized) continue;
+
+                        // not sinusoidal : direct samples up to the next rising zero crossing (or 64 samples)
+                        size_t end = i + 1;
+                        while (end < size && end - i < 64 && !(x[end - 1] < 0.f && x[end] >= 0.f)) ++end;
+                        std::vector<uint8_t> raw;
+                        for (size_t k = i; k < end; ++k) raw.push_back(toSample(x[k]));
+                        push(prog, PlayMode::Direct, raw.data(), raw.size(), (uint32_t)raw.size(), 0.f);
+                        i = end;
+                    }
+                    return prog;
+                }
+            }
+
+            // pcm : -1 - 1 at 8 kHz (see resample())
+            // when the result exceeds the budget, tolerance is relaxed step by step
+            inline Program compilePCM(const float* pcm, const size_t size, const Options& opt = Options())
+            {
+                float tolerance = opt.tolerance;
+                Program prog;
+                for (uint8_t attempt = 0; attempt < 6; ++attempt)
+                {
+                    prog = detail::compile(pcm, size, tolerance, opt.silence);
+                    if (prog.fitsInto(opt)) return prog;
+                    tolerance *= 1.5f;
+                }
+                prog.fits = false;
+                return prog;
+            }
+
+            // envelope : chunks with linear amplitude steps of at most `step_ms` between breakpoints
+            inline Program compileEnvelope(const std::vector<EnvelopePoint>& env, const float step_ms = 10.f, const Options& opt = Options())
+            {
+                Program prog;
+                double ideal = 0., emitted = 0.; // samples : the remainder of a step is carried into the next one
+                for (size_t k = 0; k + 1 < env.size(); ++k)
+                {
+                    const EnvelopePoint& a = env[k];
+                    const EnvelopePoint& b = env[k + 1];
+                    const long f = lround(a.hz / FREQ_STEP);
+                    const uint8_t freq = (uint8_t)((f < 1) ? 1 : ((f > 255) ? 255 : f));
+                    const float span = b.ms - a.ms;
+                    if (span <= 0.f) continue;
+
+                    const bool flat = fabsf(b.amp - a.amp) < 1.f / 255.f;
+                    const uint32_t steps = flat ? 1 : (uint32_t)ceilf(span / step_ms);
+                    for (uint32_t s = 0; s < steps; ++s)
+                    {
+                        const float t = (s + 0.5f) / steps;
+                        const float amp = a.amp + (b.amp - a.amp) * t;
+                        ideal += (double)span / steps * SAMPLE_RATE / 1000.;
+                        double cycles = (ideal - emitted) / SAMPLE_RATE * FREQ_STEP * freq;
+                        while (cycles >= 0.5)
+                        {
+                            const uint8_t c = (uint8_t)((cycles > 255.) ? 255 : lround(cycles));
+                            const Chunk chunk {(uint8_t)fminf(255.f, roundf(amp * 255.f)), freq, c, 0};
+                            detail::pushChunk(prog, chunk, (uint32_t)lround(detail::chunkSamples(freq, c)), 0.f);
+                            emitted += detail::chunkSamples(freq, c);
+                            cycles -= c;
+                        }
+                    }
+                }
+                prog.fits = prog.fitsInto(opt);
+                return prog;
+            }
+
+            // C++ header : one array per segment and a playback sequence (effect ids from first_id)
+            inline std::string emitHeader(const Program& prog, const std::string& name, const uint8_t first_id = 1)
+            {
+                std::string out;
+                char buf[256];
+                out += "// generated by the DRV2667 waveform compiler\n#pragma once\n#include \"DRV2667.h\"\n\n";
+                snprintf(buf, sizeof(buf), "// %u segments, %u bytes of RAM, %u ms\n\n",
+                    (unsigned)prog.segments.size(), (unsigned)prog.bytes(), (unsigned)(prog.samples() / 8));
+                out += buf;
+
+                for (size_t i = 0; i < prog.segments.size(); ++i)
+                {
+                    const Segment& s = prog.segments[i];
+                    const bool synth = (s.mode == PlayMode::Synthesis);
+                    if (synth)
+                        snprintf(buf, sizeof(buf), "const EmbeddedDevices::DRV2667::Chunk %s_%u[] {\n", name.c_str(), (unsigned)i);
+                    else
+                        snprintf(buf, sizeof(buf), "const uint8_t %s_%u[] {\n", name.c_str(), (unsigned)i);
+                    out += buf;
+                    const size_t per_line = synth ? 4 : 16;
+                    for (size_t k = 0; k < s.bytes.size(); k += per_line)
+                    {
+                        out += "    ";
+                        if (synth)
+                        {
+                            snprintf(buf, sizeof(buf), "{%u, 0x%02X, %u, 0x%02X},", s.bytes[k], s.bytes[k + 1], s.bytes[k + 2], s.bytes[k + 3]);
+                            out += buf;
+                        }
+                        else
+                            for (size_t m = k; m < k + per_line && m < s.bytes.size(); ++m)
+                            {
+                                snprintf(buf, sizeof(buf), "0x%02X,", s.bytes[m]);
+                                out += buf;
+                            }
+                        out += "\n";
+                    }
+                    out += "};\n";
+                }
+
+                out += "\n// load in this order so that effect ids match the sequence\n";
+                out += "// false at the first effect which does not fit (the ones before it stay loaded)\n";
+                snprintf(buf, sizeof(buf), "inline bool %s_load(EmbeddedDevices::DRV2667::Effects& effects)\n{\n", name.c_str());
+                out += buf;
+                for (size_t i = 0; i < prog.segments.size(); ++i)
+                {
+                    if (prog.segments[i].mode == PlayMode::Synthesis)
+                        snprintf(buf, sizeof(buf), "    if (!effects.append(%s_%u, sizeof(%s_%u) / sizeof(%s_%u[0]))) return false;\n",
+                            name.c_str(), (unsigned)i, name.c_str(), (unsigned)i, name.c_str(), (unsigned)i);
+                    else
+                        snprintf(buf, sizeof(buf), "    if (!effects.append(%s_%u, sizeof(%s_%u))) return false;\n", name.c_str(), (unsigned)i, name.c_str(), (unsigned)i);
+                    out += buf;
+                }
+                out += "    return true;\n}\n";
+
+                if (prog.segments.size() <= SEQUENCE_SLOTS)
+                {
+                    snprintf(buf, sizeof(buf), "\nconst EmbeddedDevices::DRV2667::Sequence %s_sequence {{", name.c_str());
+                    out += buf;
+                    for (size_t i = 0; i < prog.segments.size(); ++i)
+                    {
+                        snprintf(buf, sizeof(buf), "%s%u", i ? ", " : "", (unsigned)(first_id + i));
+                        out += buf;
+                    }
+                    out += "}};\n";
+                }
+                else
+                    out += "\n// more than 8 segments : split playback into several sequences\n";
+                return out;
+            }
+        }
+    }
+}
+
+#endif // __AVR__
+
+#endif // DRV2667_COMPILER_H
@@ -0,0 +1,246 @@
+#pragma once
+#ifndef DRV2667_DEVICEARRAY_H
+#define DRV2667_DEVICEARRAY_H
+
+        // The DRV2667 has a fixed I2C address (0x59), so several actuators are connected through
+        // I2C switches (TCA9548A / PCA9548A) and / or several TwoWire buses.
+        // A switch can enable more than one channel at once : writes then reach every enabled
+        // device simultaneously. DeviceArray uses this to upload one effect library image and to
+        // trigger go() on all devices behind the same switch with a single transaction.
+        // Devices are grouped by identical cached register state; each group costs one broadcast.
+        // Constructed with an Effects store, the array makes every device work on that one library
+        // (build with DRV2667_EMBED_EFFECTS 0 so that drivers do not carry a store each).
+
+namespace EmbeddedDevices
+{
+    namespace DRV2667
+    {
+        // TCA9548A / PCA9548A 8 channel I2C switch, selected channels are cached
+        class Mux
+        {
+        public:
+
+            explicit Mux(TwoWire& w = Wire, const uint8_t addr = 0x70)
+            : wire_(&w)
+            , addr_(addr)
+            {}
+
+            // bit n enables channel n
+            bool select(const uint8_t mask)
+            {
+                if (known_ && mask == mask_) return true;
+                wire_->beginTransmission(addr_);
+                wire_->write(mask);
+                known_ = (wire_->endTransmission() == 0);
+                mask_ = mask;
+                return known_;
+            }
+            uint8_t selected() const { return mask_; }
+            void invalidate() { known_ = false; }
+
+            TwoWire& getWire() const { return *wire_; }
+
+        private:
+
+            TwoWire* wire_;
+            uint8_t addr_;
+            uint8_t mask_ {0};
+            bool known_ {false};
+        };
+
+        template <uint8_t N = 8>
+        class DeviceArray
+        {
+            static_assert(N > 0 && N <= 32, "DeviceArray supports up to 32 devices");
+
+        public:
+
+            // bit i selects device i
+            using Group = uint32_t;
+            static const Group ALL = 0xFFFFFFFF;
+
+            DeviceArray() {}
+            explicit DeviceArray(Effects& library) : library_(&library) {}
+
+            // register a device on bus, optionally behind channel of mux, returns its index (-1 : full)
+            int8_t add(DRV2667& drv, TwoWire& bus = Wire, Mux* mux = nullptr, const uint8_t channel = 0)
+            {
+                if (size_ >= N) return -1;
+                drv.attatch(bus, drv.getAddress());
+                if (library_) drv.useEffects(*library_, true);
+                nodes_[size_] = Node {&drv, &bus, mux, uint8_t(1 << channel)};
+                return size_++;
+            }
+
+            uint8_t size() const { return size_; }
+
+            // route the bus to device i alone and return its driver for individual access
+            DRV2667& select(const uint8_t i)
+            {
+                route(nodes_[i], nodes_[i].channel);
+                return *nodes_[i].drv;
+            }
+
+            // run fn(DRV2667&) for every device of the group
+            // devices behind one mux with identical cached state share a single broadcast
+            template <typename F>
+            void apply(const Group group, F fn)
+            {
+                Group done = 0;
+                for (uint8_t i = 0; i < size_; ++i)
+                {
+                    if (!(group & (1UL << i)) || (done & (1UL << i))) continue;
+                    const Group members = segment(i, group);
+                    done |= members;
+                    broadcast(i, members, fn);
+                }
+            }
+
+            // upload the same RAM image to every device of the group
+            void upload(const uint8_t* image, const uint16_t size, const Group group = ALL)
+            {
+                apply(group, [&](DRV2667& d) { d.writeRAM(0x000, image, size); });
+            }
+            template <typename Image>
+            void upload(const Image& image, const Group group = ALL) { upload(image.data(), image.size(), group); }
+            void upload(const Effects& effects, const Group group = ALL) { upload(effects.image(), effects.getImageSize(), group); }
+
+            // shared library (constructor) : edit it through getEffects(), then write the changed ranges to
+            // every device at once; the library is clean afterwards. Whole library : upload(getEffects())
+            // syncs of a single driver write its own device only and leave the ranges dirty for this one
+            Effects& getEffects() { return *library_; }
+            void syncEffects()
+            {
+                if (!library_ || !library_->isDirty()) return;
+                const Effects& e = *library_;
+                apply(ALL, [&](DRV2667& d)
+                {
+                    for (uint8_t i = 0; i < e.dirtySpans(); ++i)
+                        d.writeRAM(e.dirtySpan(i).begin, e.image() + e.dirtySpan(i).begin, e.dirtySpan(i).end - e.dirtySpan(i).begin);
+                });
+                library_->clearDirty();
+            }
+
+            // trigger the group with minimal skew : routes are prepared first where possible,
+            // then one GO per mux (or device) is sent back to back
+            void go(const Group group = ALL)
+            {
+                standby(false, group);
+
+                Group done = 0;
+                for (uint8_t i = 0; i < size_; ++i)
+                {
+                    if (!(group & (1UL << i)) || (done & (1UL << i))) continue;
+                    const Group members = segment(i, group);
+                    done |= members;
+                    if (segmentsOnBus(i, group) == 1 && canBroadcast(i, members)) route(nodes_[i], channels(members));
+                }
+
+                apply(group, [](DRV2667& d) { d.go(); });
+            }
+
+            void play(const Sequence& seq, const Group group = ALL)
+            {
+                apply(group, [&](DRV2667& d) { d.setSequence(seq); });
+                go(group);
+            }
+
+            void gain(const DRV2667::Gain g, const Group group = ALL) { apply(group, [=](DRV2667& d) { d.gain(g); }); }
+            void standby(const bool b, const Group group = ALL) { apply(group, [=](DRV2667& d) { d.standby(b); }); }
+            void setSequence(const Sequence& seq, const Group group = ALL) { apply(group, [&](DRV2667& d) { d.setSequence(seq); }); }
+
+        private:
+
+            struct Node
+            {
+                DRV2667* drv;
+                TwoWire* bus;
+                Mux* mux;
+                uint8_t channel; // channel bit
+            };
+
+            // devices of the group on the same bus and mux as device i
+            Group segment(const uint8_t i, const Group group) const
+            {
+                Group members = 0;
+                for (uint8_t j = i; j < size_; ++j)
+                    if ((group & (1UL << j)) && nodes_[j].bus == nodes_[i].bus && nodes_[j].mux == nodes_[i].mux)
+                        members |= (1UL << j);
+                return members;
+            }
+
+            uint8_t segmentsOnBus(const uint8_t i, const Group group) const
+            {
+                uint8_t n = 0;
+                Group seen = 0;
+                for (uint8_t j = 0; j < size_; ++j)
+                {
+                    if (!(group & (1UL << j)) || (seen & (1UL << j)) || nodes_[j].bus != nodes_[i].bus) continue;
+                    seen |= segment(j, group);
+                    ++n;
+                }
+                return n;
+            }
+
+            uint8_t channels(const Group members) const
+            {
+                uint8_t mask = 0;
+                for (uint8_t j = 0; j < size_; ++j)
+                    if (members & (1UL << j)) mask |= nodes_[j].channel;
+                return mask;
+            }
+
+            // devices of members sharing the cached state of lead, one per mux channel
+            Group sameState(const uint8_t lead, const Group members) const
+            {
+                Group same = (1UL << lead);
+                uint8_t used = nodes_[lead].channel;
+                if (!nodes_[lead].mux) return same;
+                for (uint8_t j = 0; j < size_; ++j)
+                {
+                    if (!(members & (1UL << j)) || j == lead || (used & nodes_[j].channel)) continue;
+                    if (!nodes_[j].drv->hasSameState(*nodes_[lead].drv)) continue;
+                    used |= nodes_[j].channel;
+                    same |= (1UL << j);
+                }
+                return same;
+            }
+
+            bool canBroadcast(const uint8_t lead, const Group members) const
+            {
+                return sameState(lead, members) == members;
+            }
+
+            // one transaction set per class of identical state, devices alone otherwise
+            template <typename F>
+            void broadcast(uint8_t lead, Group members, F& fn)
+            {
+                while (members)
+                {
+                    while (!(members & (1UL << lead))) ++lead;
+                    const Group same = sameState(lead, members);
+                    route(nodes_[lead], channels(same));
+                    fn(*nodes_[lead].drv);
+                    for (uint8_t j = 0; j < size_; ++j)
+                        if ((same & (1UL << j)) && j != lead) nodes_[j].drv->copyStateFrom(*nodes_[lead].drv);
+                    members &= ~same;
+                }
+            }
+
+            // enable channels on the mux of node, disconnect other muxes of the same bus
+            void route(const Node& node, const uint8_t mask)
+            {
+                for (uint8_t j = 0; j < size_; ++j)
+                    if (nodes_[j].bus == node.bus && nodes_[j].mux && nodes_[j].mux != node.mux)
+                        nodes_[j].mux->select(0x00);
+                if (node.mux) node.mux->select(mask);
+            }
+
+            Node nodes_[N];
+            uint8_t size_ {0};
+            Effects* library_ {nullptr};
+        };
+    }
+}
+
+#endif // DRV2667_DEVICEARRAY_H
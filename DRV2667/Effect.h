@@ -2,9 +2,38 @@
 #ifndef DRV2667_EFFECT_H
 #define DRV2667_EFFECT_H
 
-#ifndef __AVR__
+#include <stddef.h>
+
+// effect builders (Synthesizer, Waveform) grow on the heap, or use fixed DRV2667_BUILDER_BYTES storage without heap
+#ifndef DRV2667_USE_HEAP
+    #ifdef __AVR__
+        #define DRV2667_USE_HEAP 0
+    #else
+        #define DRV2667_USE_HEAP 1
+    #endif
+#endif
+#ifndef DRV2667_BUILDER_BYTES
+    #define DRV2667_BUILDER_BYTES 64
+#endif
+
+// capacity of the driver's Effects : max number of effects and bytes of the RAM shadow image
+#ifndef DRV2667_MAX_EFFECTS
+    #ifdef __AVR__
+        #define DRV2667_MAX_EFFECTS 8
+    #else
+        #define DRV2667_MAX_EFFECTS 50
+    #endif
+#endif
+#ifndef DRV2667_RAM_BYTES
+    #ifdef __AVR__
+        #define DRV2667_RAM_BYTES 512
+    #else
+        #define DRV2667_RAM_BYTES 2048
+    #endif
+#endif
+
+#if DRV2667_USE_HEAP
 #include <vector>
-#include <memory>
 #include <initializer_list>
 #endif
 
@@ -53,137 +82,447 @@ namespace EmbeddedDevices
     {
         enum class PlayMode { Direct, Synthesis };
 
-#ifdef __AVR__
-
-        struct Synthesizer
+        // one sinusoidal chunk of the waveform synthesizer, same byte order as in RAM
+        struct Chunk
         {
             uint8_t amp;
             uint8_t freq;
             uint8_t cycle;
             uint8_t envelop;
         };
+        using SynthChunk = Chunk; // name used by earlier versions
+
+        // waveform ids played in order by go() (registers 0x03 - 0x0A), id 0 ends the sequence
+        // e.g. Sequence seq {{1, 3, 2}};
+        struct Sequence
+        {
+            uint8_t ids[8];
+        };
+
+        // playback rate of both modes
+        static const uint16_t SAMPLE_RATE = 8000;
+
+        // Total Ramp Time (to full scale) of an envelope nibble
+        // 0 : no ramp, 1 - 8 : 32 - 256 ms in 32 ms steps, 9 - F : 512 - 2048 ms in 256 ms steps
+        constexpr uint16_t rampMs(const uint8_t nibble)
+        {
+            return (nibble == 0) ? 0 : ((nibble <= 8) ? 32 * nibble : 512 + 256 * (nibble - 9));
+        }
+
+        // ramp of a chunk in samples : a ramp to a fraction of full scale takes the same fraction of the time
+        constexpr uint32_t rampSamples(const uint8_t nibble, const uint8_t amp)
+        {
+            return (uint32_t)rampMs(nibble & 0x0F) * (SAMPLE_RATE / 1000) * amp / 255;
+        }
+
+        // phase increment per sample of a 16 bit phase : 7.8125 Hz x freq / 8 kHz x 65536 = freq x 64
+        constexpr uint32_t phaseStep(const uint8_t freq)
+        {
+            return (uint32_t)freq << 6;
+        }
+
+        // samples of the programmed cycles (ramp-up included, ramp-down not)
+        constexpr uint32_t cycleSamples(const uint8_t freq, const uint8_t cycle)
+        {
+            return (freq == 0) ? 0 : (((uint32_t)cycle << 16) + phaseStep(freq) - 1) / phaseStep(freq);
+        }
+
+        // samples of a chunk including the appended ramp-down
+        constexpr uint32_t chunkSamples(const Chunk& c)
+        {
+            return (c.freq == 0) ? 0 : cycleSamples(c.freq, c.cycle) + rampSamples(c.envelop, c.amp);
+        }
+
+        // durations which never end (repeat count 0)
+        static const uint32_t INFINITE_SAMPLES = 0xFFFFFFFF;
+
+        constexpr uint32_t samplesToUs(const uint32_t n)
+        {
+            return (n >= 0xFFFFFFFF / (1000000 / SAMPLE_RATE)) ? 0xFFFFFFFF : n * (1000000 / SAMPLE_RATE);
+        }
+
+        // storage policies of the effect builders below : one builder template, growable on the heap
+        // where the standard library is available, fixed size without heap otherwise (AVR)
+
+#if DRV2667_USE_HEAP
+        class HeapStorage
+        {
+        public:
+            static const uint16_t CAPACITY = 0xFFFF;
+
+            bool assign(const uint8_t* const data, const uint16_t size)
+            {
+                raw_.assign(data, data + size);
+                return true;
+            }
+            void reserve(const uint16_t n) { raw_.reserve(n); }
+            bool append(const uint8_t* const data, const uint16_t size)
+            {
+                raw_.insert(raw_.end(), data, data + size);
+                return true;
+            }
+            const bool overflow() const { return false; }
+
+            const uint8_t* data() const { return raw_.data(); }
+            const uint16_t size() const { return raw_.size(); }
+            uint8_t& operator[](const uint16_t i) { return raw_[i]; }
+            const uint8_t operator[](const uint16_t i) const { return raw_[i]; }
+
+        private:
+            std::vector<uint8_t> raw_;
+        };
+#endif
+
+        // at most N bytes : an append which does not fit stores nothing, returns false and sets overflow()
+        template <uint16_t N>
+        class FixedStorage
+        {
+        public:
+            static const uint16_t CAPACITY = N;
+
+            bool assign(const uint8_t* const data, const uint16_t size)
+            {
+                size_ = 0;
+                overflow_ = false;
+                return append(data, size);
+            }
+            void reserve(const uint16_t) {}
+            bool append(const uint8_t* const data, const uint16_t size)
+            {
+                if (size > N - size_)
+                {
+                    overflow_ = true;
+                    return false;
+                }
+                for (uint16_t i = 0; i < size; ++i) raw_[size_++] = data[i];
+                return true;
+            }
+            const bool overflow() const { return overflow_; }
+
+            const uint8_t* data() const { return raw_; }
+            const uint16_t size() const { return size_; }
+            uint8_t& operator[](const uint16_t i) { return raw_[i]; }
+            const uint8_t operator[](const uint16_t i) const { return raw_[i]; }
+
+        private:
+            uint8_t raw_[N];
+            uint16_t size_ {0};
+            bool overflow_ {false};
+        };
 
+#if DRV2667_USE_HEAP
+        using DefaultStorage = HeapStorage;
 #else
+        using DefaultStorage = FixedStorage<DRV2667_BUILDER_BYTES>;
+#endif
 
-        class ChunkBase
+        // effect built before appending to Effects, bytes are kept as laid out in RAM
+        template <typename Storage>
+        class BasicChunkBase
         {
         public:
-            ChunkBase(std::initializer_list<std::vector<uint8_t>> list)
-            : repeat_(1)
-            , size_(list.size())
-            , raw_(list.begin(), list.end())
+            BasicChunkBase(const PlayMode mode, const uint8_t repeat = 1)
+            : repeat_(repeat)
+            , mode_(mode)
             {}
-            virtual ~ChunkBase() {}
 
-            const uint8_t data(const uint8_t i) const { return raw_.front()[i]; }
-            const uint8_t size() const { return size_; }
+            const uint8_t data(const uint16_t i) const { return raw_[i]; }
+            const uint8_t* data() const { return raw_.data(); }
+            const uint16_t bytes() const { return raw_.size(); }
             const uint8_t repeat() const { return repeat_; }
             void setRepeat(uint8_t r) { repeat_ = r; }
+            // data did not fit the storage : Effects refuses to add the effect
+            const bool overflow() const { return raw_.overflow(); }
 
-            virtual const uint8_t amp(const uint8_t i) const = 0;
-            virtual const uint8_t freq(const uint8_t i) const = 0;
-            virtual const uint8_t cycle(const uint8_t i) const = 0;
-            virtual const uint8_t envelop(const uint8_t i) const = 0;
-
-            virtual void amp(const uint8_t i, const uint8_t v) { }
-            virtual void freq(const uint8_t i, const uint8_t v) { }
-            virtual void cycle(const uint8_t i, const uint8_t v) { }
-            virtual void envelop(const uint8_t i, const uint8_t v) { }
+            const PlayMode getPlayMode() const { return mode_; }
 
-            virtual const PlayMode getPlayMode() const = 0;
-
-        // private:
+        protected:
             uint8_t repeat_;
-            uint8_t size_;
-            std::vector<std::vector<uint8_t>> raw_;
+            PlayMode mode_;
+            Storage raw_;
         };
 
-        class Waveform : public ChunkBase
+        template <typename Storage>
+        class BasicWaveform : public BasicChunkBase<Storage>
         {
         public:
-            Waveform(const uint8_t* const data, const uint16_t size, const uint8_t repeat = 1)
-            : ChunkBase({})
+            BasicWaveform(const uint8_t* const data, const uint16_t size, const uint8_t repeat = 1)
+            : BasicChunkBase<Storage>(PlayMode::Direct, repeat)
             {
-                this->repeat_ = repeat;
-                this->size_ = size;
-                std::vector<uint8_t> v;
-                for (uint16_t i = 0; i < size; ++i) v.push_back(data[i]);
-                this->raw_.push_back(std::move(v));
+                this->raw_.assign(data, size);
             }
-            virtual ~Waveform() {}
-
-            virtual const uint8_t amp(const uint8_t i) const override { return 0; }
-            virtual const uint8_t freq(const uint8_t i) const override { return 0; }
-            virtual const uint8_t cycle(const uint8_t i) const override { return 0; }
-            virtual const uint8_t envelop(const uint8_t i) const override { return 0; }
 
-            virtual const PlayMode getPlayMode() const override { return PlayMode::Direct; }
+            const uint16_t size() const { return this->raw_.size(); }
         };
 
-        class Synthesizer : public ChunkBase
+        template <typename Storage>
+        class BasicSynthesizer : public BasicChunkBase<Storage>
         {
         public:
-            // Synthesizer() {}
-            Synthesizer(std::initializer_list<std::vector<uint8_t>> list)
-            : ChunkBase(list)
+            static const uint8_t CHUNK_BYTES = sizeof(Chunk);
+
+            BasicSynthesizer()
+            : BasicChunkBase<Storage>(PlayMode::Synthesis)
+            {}
+            template <size_t N>
+            BasicSynthesizer(const Chunk (&chunks)[N])
+            : BasicChunkBase<Storage>(PlayMode::Synthesis)
+            {
+                static_assert(N * CHUNK_BYTES <= Storage::CAPACITY, "too many chunks for the synthesizer storage (see DRV2667_BUILDER_BYTES)");
+                this->raw_.reserve(N * CHUNK_BYTES);
+                for (const auto& c : chunks) appendChunk(c.amp, c.freq, c.cycle, c.envelop);
+            }
+#if DRV2667_USE_HEAP
+            BasicSynthesizer(std::initializer_list<Chunk> list)
+            : BasicChunkBase<Storage>(PlayMode::Synthesis)
             {
+                this->raw_.reserve(list.size() * CHUNK_BYTES);
+                for (const auto& c : list) appendChunk(c.amp, c.freq, c.cycle, c.envelop);
             }
+#endif
 
-            void appendChunk(uint8_t amp, uint8_t freq, uint8_t cycle, uint8_t envelop)
+            // false if the chunk does not fit the storage (see overflow())
+            bool appendChunk(uint8_t amp, uint8_t freq, uint8_t cycle, uint8_t envelop)
             {
-                raw_.emplace_back(std::vector<uint8_t> {amp, freq, cycle, envelop});
+                const uint8_t chunk[CHUNK_BYTES] {amp, freq, cycle, envelop};
+                return this->raw_.append(chunk, CHUNK_BYTES);
             }
 
-            const uint16_t size() const { return raw_.size(); }
+            const uint16_t size() const { return this->raw_.size() / CHUNK_BYTES; }
 
-            virtual const uint8_t amp(const uint8_t i) const override { return raw_[i][0]; }
-            virtual const uint8_t freq(const uint8_t i) const override { return raw_[i][1]; }
-            virtual const uint8_t cycle(const uint8_t i) const override { return raw_[i][2]; }
-            virtual const uint8_t envelop(const uint8_t i) const override { return raw_[i][3]; }
+            const uint8_t amp(const uint8_t i) const { return this->raw_[i * CHUNK_BYTES + 0]; }
+            const uint8_t freq(const uint8_t i) const { return this->raw_[i * CHUNK_BYTES + 1]; }
+            const uint8_t cycle(const uint8_t i) const { return this->raw_[i * CHUNK_BYTES + 2]; }
+            const uint8_t envelop(const uint8_t i) const { return this->raw_[i * CHUNK_BYTES + 3]; }
 
-            virtual void amp(const uint8_t i, const uint8_t v) override { raw_[i][0] = v; }
-            virtual void freq(const uint8_t i, const uint8_t v) override { raw_[i][1] = v; }
-            virtual void cycle(const uint8_t i, const uint8_t v) override { raw_[i][2] = v; }
-            virtual void envelop(const uint8_t i, const uint8_t v) override { raw_[i][3] = v; }
+            void amp(const uint8_t i, const uint8_t v) { this->raw_[i * CHUNK_BYTES + 0] = v; }
+            void freq(const uint8_t i, const uint8_t v) { this->raw_[i * CHUNK_BYTES + 1] = v; }
+            void cycle(const uint8_t i, const uint8_t v) { this->raw_[i * CHUNK_BYTES + 2] = v; }
+            void envelop(const uint8_t i, const uint8_t v) { this->raw_[i * CHUNK_BYTES + 3] = v; }
+        };
 
-            virtual const PlayMode getPlayMode() const override { return PlayMode::Synthesis; }
+        using ChunkBase = BasicChunkBase<DefaultStorage>;
+        using Waveform = BasicWaveform<DefaultStorage>;
+        using Synthesizer = BasicSynthesizer<DefaultStorage>;
+
+        // RAM placement of one effect, offset is relative to the start of payloads
+        // payloads are not ordered by id : removed effects leave holes which are reused or compacted
+        struct Layout
+        {
+            uint16_t offset;
+            uint16_t bytes;
+            uint8_t mode_bits;
+            uint8_t repeat;
         };
 
+        // contiguous range of RAM bytes [begin, end) which differs from the chip
+        struct Span
+        {
+            uint16_t begin;
+            uint16_t end;
+        };
 
-        class Effects
+        // effect store without heap : payloads live in a RAM image arena, described by a fixed layout table
+        // effects can be appended, inserted, replaced and removed; ids (header slots) of the following effects
+        // shift on insert / remove, payloads stay in place unless compact() has to move them
+        // offset 0xFF of every RAM page is the page register : payloads never cover it, so one payload is
+        // at most MAX_PAYLOAD_BYTES (255) long and never crosses a page boundary
+        template <uint8_t MAX_EFFECTS = 50, uint16_t RAM_BYTES = 2048>
+        class BasicEffects
         {
+            static_assert(MAX_EFFECTS <= 50, "the header table has to end before the page register at 0x0FF");
+            static_assert(RAM_BYTES <= 2048, "DRV2667 RAM is 2 KB");
+
         public:
-            void append(const uint8_t* const data, const uint16_t size, uint8_t repeat = 1)
+            bool append(const uint8_t* const data, const uint16_t size, uint8_t repeat = 1)
+            {
+                return insert(PlayMode::Direct, size_, data, size, repeat);
+            }
+            bool append(const Chunk* const chunks, const uint16_t size, uint8_t repeat = 1)
+            {
+                return insert(PlayMode::Synthesis, size_, (const uint8_t*)chunks, chunkBytes(size), repeat);
+            }
+            // repeat count of the synthesizer unless one is given
+            template <typename Storage>
+            bool append(const BasicSynthesizer<Storage>& synth)
+            {
+                return append(synth, synth.repeat());
+            }
+            template <typename Storage>
+            bool append(const BasicSynthesizer<Storage>& synth, uint8_t repeat)
+            {
+                return insert(PlayMode::Synthesis, size_, synth.data(), builderBytes(synth), repeat);
+            }
+            template <typename Storage>
+            bool append(const BasicWaveform<Storage>& wave)
+            {
+                return insert(PlayMode::Direct, size_, wave.data(), builderBytes(wave), wave.repeat());
+            }
+
+            // new effect at id i (0 - size()), effects from i move to i + 1
+            bool insert(const uint8_t i, const uint8_t* const data, const uint16_t size, uint8_t repeat = 1)
+            {
+                return insert(PlayMode::Direct, i, data, size, repeat);
+            }
+            bool insert(const uint8_t i, const Chunk* const chunks, const uint16_t size, uint8_t repeat = 1)
+            {
+                return insert(PlayMode::Synthesis, i, (const uint8_t*)chunks, chunkBytes(size), repeat);
+            }
+
+            // new contents for effect i : written in place if it fits, only changed bytes are uploaded
+            bool replace(const uint8_t i, const uint8_t* const data, const uint16_t size, uint8_t repeat = 1)
+            {
+                return replace(PlayMode::Direct, i, data, size, repeat);
+            }
+            bool replace(const uint8_t i, const Chunk* const chunks, const uint16_t size, uint8_t repeat = 1)
+            {
+                return replace(PlayMode::Synthesis, i, (const uint8_t*)chunks, chunkBytes(size), repeat);
+            }
+            template <typename Storage>
+            bool insert(const uint8_t i, const BasicSynthesizer<Storage>& synth)
+            {
+                return insert(i, synth, synth.repeat());
+            }
+            template <typename Storage>
+            bool insert(const uint8_t i, const BasicSynthesizer<Storage>& synth, uint8_t repeat)
             {
-                effects.emplace_back(std::make_shared<Waveform>(data, size, repeat));
+                return insert(PlayMode::Synthesis, i, synth.data(), builderBytes(synth), repeat);
             }
-            void append(const Synthesizer& synth, uint8_t repeat = 1)
+            template <typename Storage>
+            bool insert(const uint8_t i, const BasicWaveform<Storage>& wave)
             {
-                effects.push_back(std::make_shared<Synthesizer>(synth));
+                return insert(PlayMode::Direct, i, wave.data(), builderBytes(wave), wave.repeat());
+            }
+            template <typename Storage>
+            bool replace(const uint8_t i, const BasicSynthesizer<Storage>& synth)
+            {
+                return replace(i, synth, synth.repeat());
+            }
+            template <typename Storage>
+            bool replace(const uint8_t i, const BasicSynthesizer<Storage>& synth, uint8_t repeat)
+            {
+                return replace(PlayMode::Synthesis, i, synth.data(), builderBytes(synth), repeat);
+            }
+            template <typename Storage>
+            bool replace(const uint8_t i, const BasicWaveform<Storage>& wave)
+            {
+                return replace(PlayMode::Direct, i, wave.data(), builderBytes(wave), wave.repeat());
+            }
+
+            // effects after i move to i - 1, the payload becomes free space (only headers are rewritten)
+            bool remove(const uint8_t i)
+            {
+                if (i >= size_) return false;
+                for (uint8_t j = i; j + 1 < size_; ++j) layout_[j] = layout_[j + 1];
+                --size_;
+                writeHeaders(i);
+                return true;
+            }
+            void clear()
+            {
+                size_ = 0;
+                writeHeaders(0);
+            }
+
+            // payload bytes which can still be allocated (header slots already reserved excluded)
+            const uint16_t freeBytes() const
+            {
+                uint16_t used = 0;
+                for (uint8_t i = 0; i < size_; ++i) used += layout_[i].bytes;
+                return capacity(reserved_) - used;
+            }
+            // largest payload which fits without compact()
+            const uint16_t largestFreeBlock() const
+            {
+                uint8_t order[MAX_EFFECTS];
+                sortByOffset(order);
+                uint16_t best = 0, pos = getPayloadAddrStart();
+                for (uint8_t k = 0; k <= size_; ++k)
+                {
+                    const uint16_t end = (k < size_) ? getEffectAddrStart(order[k]) : RAM_SIZE;
+                    // split the hole at page registers
+                    for (uint16_t a = pos; a < end; a = pageEnd(a) + 1)
+                    {
+                        const uint16_t stop = (pageEnd(a) < end) ? pageEnd(a) : end;
+                        if (stop - a > best) best = stop - a;
+                    }
+                    if (k < size_) pos = end + layout_[order[k]].bytes;
+                }
+                return best;
+            }
+
+            // close holes left by remove() / replace() : highest payloads are moved into holes that fit first
+            // (fewest bytes moved), remaining ones slide down; only bytes which change become dirty
+            void compact()
+            {
+                uint8_t order[MAX_EFFECTS];
+                bool moved = true;
+                while (moved)
+                {
+                    moved = false;
+                    sortByOffset(order);
+                    for (uint8_t k = size_; k > 0 && !moved; --k)
+                    {
+                        const uint8_t i = order[k - 1];
+                        const uint16_t to = allocate(layout_[i].bytes, i, layout_[i].offset);
+                        if (to < layout_[i].offset) moved = relocate(i, to);
+                    }
+                }
+
+                sortByOffset(order);
+                const uint16_t base = getPayloadAddrStart();
+                uint16_t pos = base;
+                for (uint8_t k = 0; k < size_; ++k)
+                {
+                    const uint8_t i = order[k];
+                    const uint16_t to = fit(pos, layout_[i].bytes);
+                    if (to < getEffectAddrStart(i)) relocate(i, to - base);
+                    pos = getEffectAddrStart(i) + layout_[i].bytes;
+                }
             }
 
             static const uint8_t HEADER_BYTES = 0x05;
             static const uint8_t SYNTH_DATA_BYTES = 0x04;
-            static const uint8_t MAX_WAVEFORM_SIZE = 50;
+            static const uint8_t MAX_WAVEFORM_SIZE = MAX_EFFECTS;
             static const uint8_t SYNTH_MODE_BITS = 0x80;
+            static const uint16_t RAM_SIZE = RAM_BYTES;
+            static const uint16_t RAM_PAGE_BYTES = 256;
+            static const uint8_t MAX_PAYLOAD_BYTES = 0xFF; // one page without its page register
+            static const uint8_t HEADER_RESERVE_STEP = 8; // header slots reserved at once to keep payloads in place on append
+            static const uint8_t MAX_DIRTY_SPANS = 8;
+            static const uint8_t DIRTY_MERGE_GAP = 4; // ~ cost of a new transaction (addr + reg + page switch)
+
 
+            const uint8_t size() const { return size_; }
+            const uint16_t size(uint8_t i) const
+            {
+                return (getPlayMode(i) == PlayMode::Synthesis) ? bytes(i) / SYNTH_DATA_BYTES : bytes(i);
+            }
+            const uint16_t bytes(uint8_t i) const { return layout_[i].bytes; }
 
-            const uint8_t size() const { return effects.size(); }
-            const uint8_t size(uint8_t i) const { return effects[i]->size(); }
-            // const uint16_t bytes() const { return ;}
-            const uint16_t bytes(uint8_t i) const { return (uint16_t)effects[i]->size() * (uint16_t)SYNTH_DATA_BYTES; }
-            const uint8_t getHeaderSize() const { return effects.size() * HEADER_BYTES; }
+            // j-th byte of the effect payload as it is laid out in RAM
+            const uint8_t byteAt(const uint8_t i, const uint16_t j) const { return image_[getEffectAddrStart(i) + j]; }
+
+            const uint8_t getHeaderSize() const { return size_ * HEADER_BYTES; }
 
             const uint16_t getHeaderAddrStart(const uint8_t id) const
             {
                 return uint16_t(0x01 + HEADER_BYTES * id);
             }
 
+            // header slots kept free in front of payloads
+            void reserve(const uint8_t n)
+            {
+                if (n <= reserved_ || n > MAX_WAVEFORM_SIZE) return;
+                if (packedEnd(n) > RAM_SIZE) return;
+                move(n);
+            }
+            const uint8_t reserved() const { return reserved_; }
+            const uint16_t getPayloadAddrStart() const { return getPayloadAddrStart(reserved_); }
+
             const uint16_t getEffectAddrStart(const uint8_t id) const
             {
-                uint16_t offset = 0;
-                for (uint8_t i = 0; i < id; ++i) offset += effects[i]->size();
-                return uint16_t(0x01 + getHeaderSize() + offset);
+                return uint16_t(getPayloadAddrStart() + layout_[id].offset);
             }
             const uint8_t getEffectAddrStartL(const uint8_t id) const
             {
@@ -191,7 +530,7 @@ namespace EmbeddedDevices
             }
             const uint8_t getEffectAddrStartH(const uint8_t id) const
             {
-                return uint8_t((SYNTH_MODE_BITS + uint16_t((getEffectAddrStart(id) >> 8) & 0x00FF)));
+                return uint8_t(layout_[id].mode_bits | ((getEffectAddrStart(id) >> 8) & 0x07));
             }
             const uint16_t getEffectAddrStop(const uint8_t id) const
             {
@@ -207,39 +546,386 @@ namespace EmbeddedDevices
             }
             const uint8_t getRepeatCount(const uint8_t id) const
             {
-                return effects[id]->repeat();
+                return layout_[id].repeat;
             }
 
-            const uint8_t getEffectAddrChunk(const uint8_t id, const uint8_t n) const
+            const uint16_t getEffectAddrChunk(const uint8_t id, const uint8_t n) const
             {
-                return getEffectAddrStartL(id) + SYNTH_DATA_BYTES * n;
+                return getEffectAddrStart(id) + SYNTH_DATA_BYTES * n;
             }
 
-            const uint8_t amp(const uint8_t i, const uint8_t j) const { return effects[i]->amp(j); }
-            const uint8_t freq(const uint8_t i, const uint8_t j) const { return effects[i]->freq(j); }
-            const uint8_t cycle(const uint8_t i, const uint8_t j) const { return effects[i]->cycle(j); }
-            const uint8_t envelop(const uint8_t i, const uint8_t j) const { return effects[i]->envelop(j); }
+            const uint8_t amp(const uint8_t i, const uint8_t j) const { return image_[getEffectAddrChunk(i, j) + 0]; }
+            const uint8_t freq(const uint8_t i, const uint8_t j) const { return image_[getEffectAddrChunk(i, j) + 1]; }
+            const uint8_t cycle(const uint8_t i, const uint8_t j) const { return image_[getEffectAddrChunk(i, j) + 2]; }
+            const uint8_t envelop(const uint8_t i, const uint8_t j) const { return image_[getEffectAddrChunk(i, j) + 3]; }
 
-            void amp(const uint8_t i, const uint8_t j, const uint8_t v) { effects[i]->amp(j, v); }
-            void freq(const uint8_t i, const uint8_t j, const uint8_t v) { effects[i]->freq(j, v); }
-            void cycle(const uint8_t i, const uint8_t j, const uint8_t v) { effects[i]->cycle(j, v); }
-            void envelop(const uint8_t i, const uint8_t j, const uint8_t v) { effects[i]->envelop(j, v); }
+            void amp(const uint8_t i, const uint8_t j, const uint8_t v) { setByte(getEffectAddrChunk(i, j) + 0, v); }
+            void freq(const uint8_t i, const uint8_t j, const uint8_t v) { setByte(getEffectAddrChunk(i, j) + 1, v); }
+            void cycle(const uint8_t i, const uint8_t j, const uint8_t v) { setByte(getEffectAddrChunk(i, j) + 2, v); }
+            void envelop(const uint8_t i, const uint8_t j, const uint8_t v) { setByte(getEffectAddrChunk(i, j) + 3, v); }
 
-            const uint8_t data(uint8_t i, uint8_t j) const { return effects[i]->data(j); }
+            const uint8_t data(uint8_t i, uint16_t j) const { return byteAt(i, j); }
 
-            const uint8_t getEffectStartPage(uint8_t i) { return getEffectAddrStartH(i) + 1; }
-            const PlayMode getPlayMode(uint8_t i) { return effects[i]->getPlayMode(); }
+            const uint8_t getEffectStartPage(uint8_t i) const { return uint8_t((getEffectAddrStart(i) >> 8) + 1); }
+            const PlayMode getPlayMode(uint8_t i) const { return layout_[i].mode_bits ? PlayMode::Synthesis : PlayMode::Direct; }
+            const Layout& layout(uint8_t i) const { return layout_[i]; }
 
             const bool isMaxSize() { return (size() >= MAX_WAVEFORM_SIZE); }
 
-            void setRepeat(uint8_t i, uint8_t r) { effects[i]->setRepeat(r); }
+            void setRepeat(uint8_t i, uint8_t r)
+            {
+                layout_[i].repeat = r;
+                setByte(getHeaderAddrStart(i) + 4, r);
+            }
+
+            // playback time in 8 kHz samples (INFINITE_SAMPLES for repeat count 0), see samplesToUs()
+
+            // one pass of effect i : direct samples, or chunks with their appended ramp-down
+            const uint32_t getPassSamples(const uint8_t i) const
+            {
+                if (getPlayMode(i) == PlayMode::Direct) return bytes(i);
+                uint32_t n = 0;
+                for (uint16_t a = getEffectAddrStart(i); a + SYNTH_DATA_BYTES - 1 <= getEffectAddrStop(i); a += SYNTH_DATA_BYTES)
+                    n += chunkSamples(Chunk {image_[a], image_[a + 1], image_[a + 2], image_[a + 3]});
+                return n;
+            }
+            // effect i with its repeat count
+            const uint32_t getDurationSamples(const uint8_t i) const
+            {
+                const uint8_t repeat = getRepeatCount(i);
+                const uint32_t n = getPassSamples(i);
+                if (repeat == 0) return n ? INFINITE_SAMPLES : 0;
+                return (n > (INFINITE_SAMPLES - 1) / repeat) ? INFINITE_SAMPLES - 1 : n * repeat;
+            }
+            // whole sequence, ids as in the sequencer registers (1 - size(), 0 or an unknown id ends it)
+            const uint32_t getDurationSamples(const Sequence& seq) const
+            {
+                uint32_t n = 0;
+                for (const uint8_t id : seq.ids)
+                {
+                    if (id == 0 || id > size_) break;
+                    const uint32_t d = getDurationSamples(uint8_t(id - 1));
+                    if (d == INFINITE_SAMPLES) return INFINITE_SAMPLES;
+                    n = (d > INFINITE_SAMPLES - 1 - n) ? INFINITE_SAMPLES - 1 : n + d;
+                }
+                return n;
+            }
+            const uint32_t getDurationUs(const Sequence& seq) const { return samplesToUs(getDurationSamples(seq)); }
+
+            // shadow image of the DRV2667 RAM and the ranges not yet on the chip
+
+            const uint8_t* image() const { return image_; }
+            const uint16_t getImageSize() const { return size_ ? getPayloadAddrStart() + payloadEnd() : 1; }
+
+            const uint8_t dirtySpans() const { return n_dirty_; }
+            const Span& dirtySpan(const uint8_t i) const { return dirty_[i]; }
+            const bool isDirty() const { return n_dirty_ != 0; }
+            // bytes marked dirty so far (wraps around) : tells whether an edit changed the image
+            const uint16_t edits() const { return edits_; }
+
+            // chip contents unknown (e.g. after reset) : next sync uploads the header table and every payload
+            // reserved header slots and holes are skipped, the chip never reads them
+            void invalidate()
+            {
+                synced_ = false;
+                n_dirty_ = 0;
+                markDirty(0, getHeaderAddrStart(size_));
+                for (uint8_t i = 0; i < size_; ++i) markDirty(getEffectAddrStart(i), getEffectAddrStop(i) + 1);
+            }
+            // dirty spans have been written to the chip
+            void clearDirty()
+            {
+                synced_ = true;
+                n_dirty_ = 0;
+            }
+            // [begin, end) has been written to the chip : spans are trimmed, or split while there is room
+            void clearDirty(const uint16_t begin, const uint16_t end)
+            {
+                for (uint8_t i = 0; i < n_dirty_;)
+                {
+                    Span& span = dirty_[i];
+                    if (span.end <= begin || span.begin >= end) ++i;
+                    else if (span.begin >= begin && span.end <= end) erase(i);
+                    else if (span.begin < begin && span.end > end)
+                    {
+                        if (n_dirty_ == MAX_DIRTY_SPANS) { ++i; continue; } // stays dirty as a whole
+                        for (uint8_t j = n_dirty_; j > i + 1; --j) dirty_[j] = dirty_[j - 1];
+                        dirty_[i + 1] = Span {end, span.end};
+                        span.end = begin;
+                        ++n_dirty_;
+                        i += 2;
+                    }
+                    else
+                    {
+                        if (span.begin < begin) span.end = begin;
+                        else                    span.begin = end;
+                        ++i;
+                    }
+                }
+                if (!n_dirty_) synced_ = true;
+            }
 
         private:
 
-            std::vector<std::shared_ptr<ChunkBase>> effects;
+            const uint16_t getPayloadAddrStart(const uint8_t reserved) const { return uint16_t(0x01 + HEADER_BYTES * reserved); }
+            // payload bytes of a builder, an overflowed one gives a size insert() rejects
+            template <typename Storage>
+            static uint16_t builderBytes(const BasicChunkBase<Storage>& b) { return b.overflow() ? 0xFFFF : b.bytes(); }
+            // payload bytes of size chunks, too many chunks give a size insert() rejects
+            static uint16_t chunkBytes(const uint16_t size)
+            {
+                return (size > MAX_PAYLOAD_BYTES / SYNTH_DATA_BYTES) ? 0xFFFF : uint16_t(size * SYNTH_DATA_BYTES);
+            }
+            // end of the highest payload, relative to the start of payloads
+            const uint16_t payloadEnd() const
+            {
+                uint16_t end = 0;
+                for (uint8_t i = 0; i < size_; ++i)
+                    if (layout_[i].offset + layout_[i].bytes > end) end = layout_[i].offset + layout_[i].bytes;
+                return end;
+            }
+            // payload bytes behind the header table, page registers excluded
+            const uint16_t capacity(const uint8_t reserved) const
+            {
+                const uint16_t base = getPayloadAddrStart(reserved);
+                return uint16_t(RAM_SIZE - base - (RAM_SIZE / RAM_PAGE_BYTES - base / RAM_PAGE_BYTES));
+            }
+
+            // address of the page register of the page of addr : payloads end before it
+            static uint16_t pageEnd(const uint16_t addr) { return uint16_t(addr - addr % RAM_PAGE_BYTES + MAX_PAYLOAD_BYTES); }
+            // first address from addr where n bytes fit without covering a page register
+            static uint16_t fit(const uint16_t addr, const uint16_t n)
+            {
+                return (addr + n - 1 < pageEnd(addr)) ? addr : uint16_t(pageEnd(addr) + 1);
+            }
+            // end of all payloads laid out in offset order behind reserved header slots, plus one more of n bytes
+            const uint32_t packedEnd(const uint8_t reserved, const uint16_t n = 0) const
+            {
+                uint8_t order[MAX_EFFECTS];
+                sortByOffset(order);
+                uint32_t pos = getPayloadAddrStart(reserved);
+                for (uint8_t k = 0; k < size_; ++k) pos = fit(uint16_t(pos), layout_[order[k]].bytes) + layout_[order[k]].bytes;
+                if (n) pos = fit(uint16_t(pos), n) + n;
+                return pos;
+            }
+
+            // effect indices in order of their payload offset (insertion sort, MAX_EFFECTS is small)
+            void sortByOffset(uint8_t* order) const
+            {
+                for (uint8_t i = 0; i < size_; ++i)
+                {
+                    uint8_t k = i;
+                    for (; k > 0 && layout_[order[k - 1]].offset > layout_[i].offset; --k) order[k] = order[k - 1];
+                    order[k] = i;
+                }
+            }
+
+            // best fitting hole of n bytes below limit, effect skip is treated as free; NO_SPACE if none
+            static const uint16_t NO_SPACE = 0xFFFF;
+            const uint16_t allocate(const uint16_t n, const uint8_t skip = 0xFF, const uint16_t limit = 0xFFFF) const
+            {
+                if (n > MAX_PAYLOAD_BYTES) return NO_SPACE;
+                uint8_t order[MAX_EFFECTS];
+                sortByOffset(order);
+                const uint16_t base = getPayloadAddrStart();
+                uint16_t best = NO_SPACE, best_size = 0xFFFF, pos = 0;
+                for (uint8_t k = 0; k <= size_; ++k)
+                {
+                    if (k < size_ && order[k] == skip) continue;
+                    const uint16_t end = (k < size_) ? layout_[order[k]].offset : uint16_t(RAM_SIZE - base);
+                    const uint16_t at = fit(base + pos, n) - base;
+                    if (end >= at + n && end - pos < best_size && at < limit)
+                    {
+                        best = at;
+                        best_size = end - pos;
+                    }
+                    if (k < size_) pos = layout_[order[k]].offset + layout_[order[k]].bytes;
+                }
+                return best;
+            }
+
+            // move payload of effect i to offset to, copying away from the overlap
+            bool relocate(const uint8_t i, const uint16_t to)
+            {
+                const uint16_t from = getEffectAddrStart(i);
+                const uint16_t dst = getPayloadAddrStart() + to;
+                const uint16_t n = layout_[i].bytes;
+                if (dst < from) for (uint16_t j = 0; j < n; ++j) setByte(dst + j, image_[from + j]);
+                else            for (uint16_t j = n; j > 0; --j) setByte(dst + j - 1, image_[from + j - 1]);
+                layout_[i].offset = to;
+                writeHeaders(i);
+                return true;
+            }
+
+            bool insert(const PlayMode mode, const uint8_t i, const uint8_t* const data, const uint16_t n, const uint8_t repeat)
+            {
+                if (size_ >= MAX_WAVEFORM_SIZE || n == 0 || n > MAX_PAYLOAD_BYTES || i > size_) return false;
+
+                uint8_t reserved = reserved_;
+                if (size_ >= reserved)
+                {
+                    reserved += HEADER_RESERVE_STEP;
+                    if (reserved > MAX_WAVEFORM_SIZE) reserved = MAX_WAVEFORM_SIZE;
+                }
+                if (reserved != reserved_)
+                {
+                    // payloads are laid out again behind the larger header table, the new one after them
+                    if (packedEnd(reserved, n) > RAM_SIZE) return false;
+                    move(reserved);
+                }
+
+                uint16_t offset = allocate(n);
+                if (offset == NO_SPACE && packedEnd(reserved_, n) <= RAM_SIZE)
+                {
+                    compact();
+                    offset = allocate(n);
+                }
+                if (offset == NO_SPACE) return false;
+
+                for (uint8_t j = size_; j > i; --j) layout_[j] = layout_[j - 1];
+                layout_[i] = Layout {offset, n, uint8_t((mode == PlayMode::Synthesis) ? SYNTH_MODE_BITS : 0x00), repeat}; // repeat 0 : endlessly
+                ++size_;
+
+                const uint16_t addr = getEffectAddrStart(i);
+                for (uint16_t j = 0; j < n; ++j) setByte(addr + j, data[j]);
+                writeHeaders(i);
+                return true;
+            }
+
+            bool replace(const PlayMode mode, const uint8_t i, const uint8_t* const data, const uint16_t n, const uint8_t repeat)
+            {
+                if (i >= size_ || n == 0 || n > MAX_PAYLOAD_BYTES) return false;
+                uint16_t offset = layout_[i].offset;
+                if (n > layout_[i].bytes)
+                {
+                    offset = allocate(n, i);
+                    if (offset == NO_SPACE && freeBytes() + layout_[i].bytes >= n)
+                    {
+                        compact();
+                        offset = allocate(n, i);
+                    }
+                    if (offset == NO_SPACE) return false;
+                }
+                layout_[i] = Layout {offset, n, uint8_t((mode == PlayMode::Synthesis) ? SYNTH_MODE_BITS : 0x00), repeat};
+
+                const uint16_t addr = getEffectAddrStart(i);
+                for (uint16_t j = 0; j < n; ++j) setByte(addr + j, data[j]);
+                writeHeaders(i, i + 1);
+                return true;
+            }
+
+            // grow header area : payloads are packed behind it in offset order (around page registers),
+            // all headers change. Payloads moving down are copied in ascending order first, then those moving up
+            // in descending order, so none overwrites bytes still to be copied.
+            void move(const uint8_t reserved)
+            {
+                uint8_t order[MAX_EFFECTS];
+                uint16_t from[MAX_EFFECTS];
+                sortByOffset(order);
+                for (uint8_t i = 0; i < size_; ++i) from[i] = getEffectAddrStart(i);
+
+                const uint16_t base = getPayloadAddrStart(reserved);
+                uint16_t pos = base;
+                for (uint8_t k = 0; k < size_; ++k)
+                {
+                    const uint8_t i = order[k];
+                    pos = fit(pos, layout_[i].bytes);
+                    layout_[i].offset = pos - base;
+                    pos += layout_[i].bytes;
+                }
+                reserved_ = reserved;
+
+                for (uint8_t k = 0; k < size_; ++k)
+                {
+                    const uint8_t i = order[k];
+                    const uint16_t to = getEffectAddrStart(i);
+                    if (to < from[i]) for (uint16_t j = 0; j < layout_[i].bytes; ++j) setByte(to + j, image_[from[i] + j]);
+                }
+                for (uint8_t k = size_; k > 0; --k)
+                {
+                    const uint8_t i = order[k - 1];
+                    const uint16_t to = getEffectAddrStart(i);
+                    if (to > from[i]) for (uint16_t j = layout_[i].bytes; j > 0; --j) setByte(to + j - 1, image_[from[i] + j - 1]);
+                }
+                writeHeaders(0);
+            }
+
+            void writeHeaders(const uint8_t from, const uint8_t to = 0xFF)
+            {
+                setByte(0x000, getHeaderSize());
+                for (uint8_t i = from; i < size_ && i < to; ++i)
+                {
+                    const uint16_t h = getHeaderAddrStart(i);
+                    setByte(h + 0, getEffectAddrStartH(i));
+                    setByte(h + 1, getEffectAddrStartL(i));
+                    setByte(h + 2, getEffectAddrStopH(i));
+                    setByte(h + 3, getEffectAddrStopL(i));
+                    setByte(h + 4, layout_[i].repeat);
+                }
+            }
+
+            void setByte(const uint16_t addr, const uint8_t v)
+            {
+                if (synced_ && image_[addr] == v) return;
+                image_[addr] = v;
+                markDirty(addr, addr + 1);
+                ++edits_;
+            }
+
+            // keep spans sorted and disjoint, merging neighbours closer than DIRTY_MERGE_GAP
+            void markDirty(const uint16_t begin, const uint16_t end)
+            {
+                uint8_t i = 0;
+                while (i < n_dirty_ && dirty_[i].end + DIRTY_MERGE_GAP < begin) ++i;
+
+                if (i < n_dirty_ && dirty_[i].begin <= end + DIRTY_MERGE_GAP)
+                {
+                    if (begin < dirty_[i].begin) dirty_[i].begin = begin;
+                    if (end > dirty_[i].end) dirty_[i].end = end;
+                    while (i + 1 < n_dirty_ && dirty_[i + 1].begin <= dirty_[i].end + DIRTY_MERGE_GAP)
+                    {
+                        if (dirty_[i + 1].end > dirty_[i].end) dirty_[i].end = dirty_[i + 1].end;
+                        erase(i + 1);
+                    }
+                    return;
+                }
+
+                if (n_dirty_ == MAX_DIRTY_SPANS)
+                {
+                    // no room : merge the closest pair, then retry
+                    uint8_t k = 0;
+                    for (uint8_t j = 1; j + 1 < n_dirty_; ++j)
+                        if (dirty_[j + 1].begin - dirty_[j].end < dirty_[k + 1].begin - dirty_[k].end) k = j;
+                    dirty_[k].end = dirty_[k + 1].end;
+                    erase(k + 1);
+                    markDirty(begin, end);
+                    return;
+                }
+
+                for (uint8_t j = n_dirty_; j > i; --j) dirty_[j] = dirty_[j - 1];
+                dirty_[i] = Span {begin, end};
+                ++n_dirty_;
+            }
+
+            void erase(const uint8_t i)
+            {
+                for (uint8_t j = i; j + 1 < n_dirty_; ++j) dirty_[j] = dirty_[j + 1];
+                --n_dirty_;
+            }
+
+            uint8_t image_[RAM_SIZE] {0};
+            Layout layout_[MAX_EFFECTS];
+            uint8_t size_ {0};
+            uint8_t reserved_ {0};
+
+            Span dirty_[MAX_DIRTY_SPANS];
+            uint8_t n_dirty_ {0};
+            bool synced_ {false};
+            uint16_t edits_ {0};
         };
 
-#endif // #ifndef __AVR__
+        // the driver's effects (capacity configured by DRV2667_MAX_EFFECTS / DRV2667_RAM_BYTES)
+        using Effects = BasicEffects<DRV2667_MAX_EFFECTS, DRV2667_RAM_BYTES>;
     }
 }
 
@@ -0,0 +1,200 @@
+#pragma once
+#ifndef DRV2667_EFFECTCACHE_H
+#define DRV2667_EFFECTCACHE_H
+
+        // Effect library larger than the 2 KB RAM : effects are registered by key on the host, and load()
+        // makes one resident in the driver's Effects, evicting the least recently used ones when RAM is full.
+        // Frequently used effects therefore stay on the chip and cost no upload; pinned effects are never evicted.
+        // Chip ids change when effects are evicted, so always play through the id returned by load() / play(),
+        // and let the cache manage the driver's Effects alone.
+
+#if DRV2667_USE_HEAP
+
+#include <map>
+#include <vector>
+
+namespace EmbeddedDevices
+{
+    namespace DRV2667
+    {
+        template <typename Key = uint16_t>
+        class EffectCache
+        {
+        public:
+
+            explicit EffectCache(DRV2667& drv) : drv_(drv) {}
+
+            // false (library unchanged) if the effect cannot fit even into empty RAM, e.g. more than 255 bytes
+            bool add(const Key& key, const Synthesizer& synth)
+            {
+                return add(key, synth, synth.repeat());
+            }
+            bool add(const Key& key, const Synthesizer& synth, const uint8_t repeat)
+            {
+                return add(key, PlayMode::Synthesis, synth.data(), synth.bytes(), repeat);
+            }
+            bool add(const Key& key, const Waveform& wave)
+            {
+                return add(key, PlayMode::Direct, wave.data(), wave.bytes(), wave.repeat());
+            }
+            bool add(const Key& key, const Chunk* const chunks, const uint16_t size, const uint8_t repeat = 1)
+            {
+                return add(key, PlayMode::Synthesis, (const uint8_t*)chunks, size * sizeof(Chunk), repeat);
+            }
+            bool add(const Key& key, const uint8_t* const data, const uint16_t size, const uint8_t repeat = 1)
+            {
+                return add(key, PlayMode::Direct, data, size, repeat);
+            }
+
+            // remove from the library (and from RAM at the next load)
+            void erase(const Key& key)
+            {
+                auto it = library_.find(key);
+                if (it == library_.end()) return;
+                if (it->second.resident) evict(it);
+                library_.erase(it);
+            }
+
+            // chip id (1 - ) of key, uploaded first if needed; 0 if unknown or it cannot fit
+            uint8_t load(const Key& key)
+            {
+                auto it = library_.find(key);
+                if (it == library_.end()) return 0;
+                Entry& e = it->second;
+                e.used = ++clock_;
+
+                if (e.resident)
+                {
+                    ++hits_;
+                    return e.id + 1;
+                }
+                ++misses_;
+
+                Effects& effects = drv_.getEffects();
+                while (!append(effects, e))
+                    if (!evictOldest()) return 0;
+                e.resident = true;
+                e.id = effects.size() - 1;
+                drv_.syncEffects();
+                return e.id + 1;
+            }
+
+            // load and play one effect, false if it could not be loaded
+            bool play(const Key& key)
+            {
+                const uint8_t id = load(key);
+                if (id == 0) return false;
+                drv_.play(Sequence {{id}});
+                return true;
+            }
+            // up to 8 effects in order : all of them are pinned while loading so they evict each other last
+            bool play(std::initializer_list<Key> keys)
+            {
+                if (keys.size() > 8) return false;
+                std::vector<Key> pinned;
+                bool ok = true;
+                for (const Key& k : keys)
+                {
+                    auto it = library_.find(k);
+                    if (it == library_.end()) { ok = false; break; }
+                    if (!it->second.pinned) pinned.push_back(k);
+                    it->second.pinned = true;
+                    if (load(k) == 0) { ok = false; break; }
+                }
+                for (const Key& k : pinned) library_[k].pinned = false;
+                if (!ok) return false;
+
+                // ids may have shifted while later keys were loaded
+                Sequence seq {};
+                uint8_t n = 0;
+                for (const Key& k : keys) seq.ids[n++] = library_[k].id + 1;
+                drv_.play(seq);
+                return true;
+            }
+
+            void pin(const Key& key, const bool b = true)
+            {
+                auto it = library_.find(key);
+                if (it != library_.end()) it->second.pinned = b;
+            }
+
+            bool isResident(const Key& key) const
+            {
+                auto it = library_.find(key);
+                return it != library_.end() && it->second.resident;
+            }
+            size_t size() const { return library_.size(); }
+
+            uint32_t hits() const { return hits_; }
+            uint32_t misses() const { return misses_; }
+            uint32_t evictions() const { return evictions_; }
+
+        private:
+
+            struct Entry
+            {
+                PlayMode mode;
+                std::vector<uint8_t> bytes;
+                uint8_t repeat;
+                bool resident;
+                bool pinned;
+                uint8_t id;    // index in Effects while resident
+                uint32_t used; // last load()
+            };
+            using Iterator = typename std::map<Key, Entry>::iterator;
+
+            bool add(const Key& key, const PlayMode mode, const uint8_t* data, const size_t size, const uint8_t repeat)
+            {
+                Entry e {mode, std::vector<uint8_t>(data, data + size), repeat, false, false, 0, 0};
+                // load() would evict every resident effect for an entry which never fits
+                Effects empty;
+                if (!append(empty, e)) return false;
+                erase(key);
+                library_[key] = std::move(e);
+                return true;
+            }
+
+            static bool append(Effects& effects, const Entry& e)
+            {
+                if (e.mode == PlayMode::Synthesis)
+                    return effects.append((const Chunk*)e.bytes.data(), uint16_t(e.bytes.size() / sizeof(Chunk)), e.repeat);
+                return effects.append(e.bytes.data(), (uint16_t)e.bytes.size(), e.repeat);
+            }
+
+            bool evictOldest()
+            {
+                Iterator oldest = library_.end();
+                for (Iterator it = library_.begin(); it != library_.end(); ++it)
+                {
+                    if (!it->second.resident || it->second.pinned) continue;
+                    if (oldest == library_.end() || it->second.used < oldest->second.used) oldest = it;
+                }
+                if (oldest == library_.end()) return false;
+                evict(oldest);
+                ++evictions_;
+                return true;
+            }
+
+            // the freed payload is reused by later loads, only headers are rewritten
+            void evict(Iterator it)
+            {
+                const uint8_t id = it->second.id;
+                drv_.getEffects().remove(id);
+                it->second.resident = false;
+                for (auto& kv : library_)
+                    if (kv.second.resident && kv.second.id > id) --kv.second.id;
+            }
+
+            DRV2667& drv_;
+            std::map<Key, Entry> library_;
+            uint32_t clock_ {0};
+            uint32_t hits_ {0};
+            uint32_t misses_ {0};
+            uint32_t evictions_ {0};
+        };
+    }
+}
+
+#endif // DRV2667_USE_HEAP
+
+#endif // DRV2667_EFFECTCACHE_H
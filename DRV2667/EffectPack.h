@@ -0,0 +1,212 @@
+#pragma once
+#ifndef DRV2667_EFFECTPACK_H
+#define DRV2667_EFFECTPACK_H
+
+        // Binary effect library ("effect pack") : the RAM image is stored verbatim, so a pack is uploaded
+        // straight from where it lives (memory mapped flash, a const array, an mmap'd file on the host)
+        // or streamed from a file / SD card through a small buffer, without building effect objects.
+        //
+        // layout (little endian)
+        //   0x00  4  magic "D2PK"
+        //   0x04  1  version (1)
+        //   0x05  1  number of effects N
+        //   0x06  2  image size S (1 - 2048)
+        //   0x08  4  CRC-32 of the image
+        //   0x0C  2  size of the name pool P
+        //   0x0E  2  reserved (0)
+        //   0x10  S  RAM image : header size, 5-byte headers, payloads (as Effects::image())
+        //   ...   8N metadata per effect : duration in samples incl. repeats (u32, 0xFFFFFFFF : endless),
+        //           name offset in the pool (u16, 0xFFFF : unnamed), reserved (u16)
+        //   ...   P  name pool : NUL terminated strings
+        //
+        // build packs with makePack() (DRV2667_USE_HEAP) or extras/pack/drv2667pack.cpp
+
+#include <string.h>
+#if DRV2667_USE_HEAP
+#include <string>
+#include <vector>
+#endif
+
+namespace EmbeddedDevices
+{
+    namespace DRV2667
+    {
+        inline uint32_t crc32(const uint8_t* data, const uint32_t size, uint32_t crc = 0)
+        {
+            crc = ~crc;
+            for (uint32_t i = 0; i < size; ++i)
+            {
+                crc ^= data[i];
+                for (uint8_t b = 0; b < 8; ++b) crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+            }
+            return ~crc;
+        }
+
+        class EffectPack
+        {
+        public:
+
+            static const uint8_t VERSION = 1;
+            static const uint8_t HEADER_SIZE = 0x10;
+            static const uint8_t META_SIZE = 8;
+            static const uint16_t UNNAMED = 0xFFFF;
+
+            EffectPack() {}
+            EffectPack(const uint8_t* pack, const uint32_t size) { map(pack, size); }
+
+            // use pack in place (no copy), false if it is malformed or the image checksum does not match
+            bool map(const uint8_t* pack, const uint32_t size)
+            {
+                pack_ = nullptr;
+                if (size < HEADER_SIZE || !parseHeader(pack, info_) || size < info_.total) return false;
+                if (pack[HEADER_SIZE] != info_.effects * 5) return false; // header size byte of the image
+                if (!validNames(pack)) return false;
+                if (crc32(pack + HEADER_SIZE, info_.image_size) != info_.crc) return false;
+                pack_ = pack;
+                return true;
+            }
+
+            bool valid() const { return pack_ != nullptr; }
+
+            // RAM image, e.g. drv.upload(pack) or DeviceArray::upload(pack)
+            const uint8_t* data() const { return pack_ + HEADER_SIZE; }
+            uint16_t size() const { return info_.image_size; }
+
+            uint8_t effects() const { return info_.effects; }
+
+            // id : 1 - effects(), as in the sequencer registers
+            uint32_t getDurationSamples(const uint8_t id) const { return (id >= 1 && id <= effects()) ? le32(meta(id)) : 0; }
+            const char* name(const uint8_t id) const
+            {
+                if (id < 1 || id > effects()) return nullptr;
+                const uint16_t offset = le16(meta(id) + 4);
+                return (offset < info_.pool_size) ? (const char*)pool() + offset : nullptr;
+            }
+            // id of the effect named s, 0 if there is none
+            uint8_t find(const char* s) const
+            {
+                for (uint8_t id = 1; id <= effects(); ++id)
+                {
+                    const char* n = name(id);
+                    if (n && strcmp(n, s) == 0) return id;
+                }
+                return 0;
+            }
+
+            struct Info
+            {
+                uint8_t effects;
+                uint16_t image_size;
+                uint32_t crc;
+                uint16_t pool_size;
+                uint32_t total; // bytes of the whole pack
+            };
+            const Info& info() const { return info_; }
+
+            // the first HEADER_SIZE bytes of a pack
+            static bool parseHeader(const uint8_t* h, Info& info)
+            {
+                if (h[0] != 'D' || h[1] != '2' || h[2] != 'P' || h[3] != 'K' || h[4] != VERSION) return false;
+                info.effects = h[5];
+                info.image_size = le16(h + 6);
+                info.crc = le32(h + 8);
+                info.pool_size = le16(h + 12);
+                info.total = HEADER_SIZE + info.image_size + (uint32_t)META_SIZE * info.effects + info.pool_size;
+                return info.image_size >= 1 && info.image_size <= 2048;
+            }
+
+            // stream the image of a pack from a file / SD card (anything with readBytes(), e.g. Stream or File)
+            // straight into the chip RAM, one burst at a time; metadata is not read. Returns false on a malformed
+            // pack, a checksum mismatch of the received bytes or an I2C error.
+            template <typename Input>
+            static bool upload(Input& in, DRV2667& drv, Info* out = nullptr)
+            {
+                uint8_t buf[DRV2667_I2C_BUFFER_LENGTH];
+                Info info;
+                if (in.readBytes((char*)buf, HEADER_SIZE) != HEADER_SIZE || !parseHeader(buf, info)) return false;
+
+                uint32_t crc = 0;
+                for (uint16_t addr = 0; addr < info.image_size;)
+                {
+                    uint16_t n = info.image_size - addr;
+                    if (n > drv.getBurstSize()) n = drv.getBurstSize();
+                    if (in.readBytes((char*)buf, n) != n) return false;
+                    if (addr == 0 && buf[0] != info.effects * 5) return false;
+                    crc = crc32(buf, n, crc);
+                    drv.writeRAM(addr, buf, n);
+                    if (drv.getI2CStatus() != 0) return false;
+                    addr += n;
+                }
+                if (out) *out = info;
+                return crc == info.crc;
+            }
+
+        private:
+
+            static uint16_t le16(const uint8_t* p) { return (uint16_t)(p[0] | (p[1] << 8)); }
+            static uint32_t le32(const uint8_t* p) { return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24); }
+
+            const uint8_t* meta(const uint8_t id) const { return pack_ + HEADER_SIZE + info_.image_size + (id - 1) * META_SIZE; }
+            const uint8_t* pool() const { return pack_ + HEADER_SIZE + info_.image_size + (uint32_t)META_SIZE * info_.effects; }
+
+            // name() never reads past the pool : it ends with NUL and every offset points into it (or is UNNAMED)
+            bool validNames(const uint8_t* pack) const
+            {
+                const uint8_t* m = pack + HEADER_SIZE + info_.image_size;
+                const uint8_t* p = m + (uint32_t)META_SIZE * info_.effects;
+                if (info_.pool_size && p[info_.pool_size - 1] != 0) return false;
+                for (uint8_t i = 0; i < info_.effects; ++i)
+                {
+                    const uint16_t offset = le16(m + i * META_SIZE + 4);
+                    if (offset != UNNAMED && offset >= info_.pool_size) return false;
+                }
+                return true;
+            }
+
+            const uint8_t* pack_ {nullptr};
+            Info info_ {};
+        };
+
+#if DRV2667_USE_HEAP
+
+        // pack of the current effects, names[i] for effect i (may be shorter than the library)
+        template <uint8_t MAX_EFFECTS, uint16_t RAM_BYTES>
+        std::vector<uint8_t> makePack(const BasicEffects<MAX_EFFECTS, RAM_BYTES>& effects, const std::vector<std::string>& names = {})
+        {
+            const uint16_t image_size = effects.getImageSize();
+            std::vector<uint8_t> pool;
+            std::vector<uint8_t> out(EffectPack::HEADER_SIZE, 0);
+            out.insert(out.end(), effects.image(), effects.image() + image_size);
+
+            auto put16 = [&](const uint16_t v) { out.push_back(uint8_t(v)); out.push_back(uint8_t(v >> 8)); };
+            auto put32 = [&](const uint32_t v) { put16(uint16_t(v)); put16(uint16_t(v >> 16)); };
+            for (uint8_t i = 0; i < effects.size(); ++i)
+            {
+                put32(effects.getDurationSamples(i));
+                if (i < names.size() && !names[i].empty())
+                {
+                    put16((uint16_t)pool.size());
+                    pool.insert(pool.end(), names[i].begin(), names[i].end());
+                    pool.push_back(0);
+                }
+                else
+                    put16(EffectPack::UNNAMED);
+                put16(0);
+            }
+            out.insert(out.end(), pool.begin(), pool.end());
+
+            const uint32_t crc = crc32(effects.image(), image_size);
+            const uint8_t header[EffectPack::HEADER_SIZE] {
+                'D', '2', 'P', 'K', EffectPack::VERSION, effects.size(),
+                uint8_t(image_size), uint8_t(image_size >> 8),
+                uint8_t(crc), uint8_t(crc >> 8), uint8_t(crc >> 16), uint8_t(crc >> 24),
+                uint8_t(pool.size()), uint8_t(pool.size() >> 8), 0, 0};
+            for (uint8_t i = 0; i < EffectPack::HEADER_SIZE; ++i) out[i] = header[i];
+            return out;
+        }
+
+#endif // DRV2667_USE_HEAP
+    }
+}
+
+#endif // DRV2667_EFFECTPACK_H
@@ -0,0 +1,144 @@
+#pragma once
+#ifndef DRV2667_FIFOSTREAM_H
+#define DRV2667_FIFOSTREAM_H
+
+#include "RingBuffer.h"
+
+        // Digital FIFO playback : 8 kHz two's complement samples written to register 0x0B are played
+        // as soon as they arrive. The FIFO holds 100 samples (12.5 ms), so it has to be refilled
+        // continuously. Samples are produced into a lock-free ring buffer (e.g. from loop()) and
+        // pump() moves them to the chip in bursts (e.g. from a timer task every few ms).
+        // The chip FIFO level is estimated from elapsed time to avoid reading the status register.
+        // end() marks the last sample of a stream : the FIFO running dry after it is not an underflow.
+
+namespace EmbeddedDevices
+{
+    namespace DRV2667
+    {
+        struct FifoStats
+        {
+            uint32_t samples;      // samples written to the chip
+            uint32_t transactions; // burst writes to the chip
+            uint32_t underflows;   // chip FIFO ran dry while streaming (before end())
+            uint32_t overflows;    // samples dropped because the ring buffer was full
+            uint32_t errors;       // failed burst writes, their samples are lost
+        };
+
+        template <uint16_t N = 1024>
+        class FifoStream
+        {
+        public:
+
+            static const uint8_t FIFO_SIZE = 100;
+            static const uint8_t FIFO_MARGIN = 4;        // headroom for clock drift between MCU and chip
+            static const uint16_t SAMPLE_PERIOD_US = 125; // 8 kHz
+
+            explicit FifoStream(DRV2667& drv) : drv_(drv) {}
+
+            void begin()
+            {
+                drv_.standby(false);
+                drv_.selectInput(DRV2667::Input::DIGITAL_IN);
+                level_ = 0;
+                playing_ = false;
+                open_ = true;
+                prev_us_ = micros();
+            }
+
+            // no more samples follow (a later write() opens the stream again)
+            void end() { open_ = false; }
+            bool isOpen() const { return open_; }
+
+            // producer side
+
+            uint16_t write(const uint8_t* samples, const uint16_t size)
+            {
+                open_ = true;
+                const uint16_t n = ring_.push(samples, size);
+                stats_.overflows += size - n;
+                return n;
+            }
+            bool write(const uint8_t sample)
+            {
+                open_ = true;
+                if (ring_.push(sample)) return true;
+                ++stats_.overflows;
+                return false;
+            }
+            uint16_t availableForWrite() const { return ring_.available(); }
+
+            // consumer side : call at least every (FIFO_SIZE - FIFO_MARGIN) * 125 us = 12 ms
+            // returns number of samples written to the chip
+            uint16_t pump()
+            {
+                consume();
+
+                uint16_t written = 0;
+                uint8_t buf[DRV2667_I2C_BUFFER_LENGTH];
+                while (level_ < FIFO_SIZE - FIFO_MARGIN && !ring_.empty())
+                {
+                    uint16_t n = FIFO_SIZE - FIFO_MARGIN - level_;
+                    if (n > drv_.getBurstSize()) n = drv_.getBurstSize();
+                    n = ring_.pop(buf, n);
+                    drv_.writeFIFO(buf, n);
+                    ++stats_.transactions;
+                    if (drv_.getI2CStatus() != 0)
+                    {
+                        ++stats_.errors; // level unchanged : retry with the next samples on the next pump()
+                        break;
+                    }
+
+                    if (!playing_)
+                    {
+                        playing_ = true;
+                        prev_us_ = micros();
+                    }
+                    level_ += n;
+                    written += n;
+                }
+                stats_.samples += written;
+                return written;
+            }
+
+            // estimated number of samples still queued in the chip FIFO
+            uint8_t level() const { return level_; }
+            bool isPlaying() const { return playing_; }
+            uint16_t buffered() const { return ring_.size(); }
+
+            const FifoStats& stats() const { return stats_; }
+            void resetStats() { stats_ = FifoStats(); }
+
+        private:
+
+            void consume()
+            {
+                if (!playing_) return;
+
+                const uint32_t elapsed = micros() - prev_us_;
+                const uint32_t consumed = elapsed / SAMPLE_PERIOD_US;
+                if (consumed < level_)
+                {
+                    level_ -= consumed;
+                    prev_us_ += consumed * SAMPLE_PERIOD_US; // keep the fraction of a sample
+                    return;
+                }
+
+                // FIFO ran dry : the normal end of a stream unless more samples were due
+                level_ = 0;
+                playing_ = false;
+                if (open_ || !ring_.empty()) ++stats_.underflows;
+            }
+
+            DRV2667& drv_;
+            RingBuffer<uint8_t, N> ring_;
+            FifoStats stats_ {};
+
+            uint8_t level_ {0};
+            bool playing_ {false};
+            volatile bool open_ {false}; // producer side
+            uint32_t prev_us_ {0};
+        };
+    }
+}
+
+#endif // DRV2667_FIFOSTREAM_H
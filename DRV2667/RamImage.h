@@ -0,0 +1,148 @@
+#pragma once
+#ifndef DRV2667_RAMIMAGE_H
+#define DRV2667_RAMIMAGE_H
+
+#include "Effect.h"
+
+// compile-time effect library : needs C++14 constexpr
+
+#if __cplusplus >= 201402L
+
+#include <stddef.h>
+
+        // usage :
+        //
+        // constexpr auto library = DRV2667::makeRamImage(
+        //     DRV2667::synth({{255, 0x15, 50, 0x09}, {255, 0x17, 50, 0x09}}),
+        //     DRV2667::waveform(samples, 2) // repeat twice
+        // );
+        // drv.upload(library);
+        //
+        // an invalid library (frequency 0, more than 50 effects or 255 bytes per effect, too large for RAM)
+        // fails to compile. Payloads are placed around offset 0xFF of each page (the page register).
+
+namespace EmbeddedDevices
+{
+    namespace DRV2667
+    {
+        // intentionally not constexpr : reaching them in a constant expression is a compile error
+        inline void synth_frequency_must_not_be_zero() {}
+        inline void effect_must_not_be_empty() {}
+
+        template <uint16_t BYTES>
+        struct EffectDef
+        {
+            PlayMode mode;
+            uint8_t repeat;
+            uint8_t data[BYTES];
+        };
+
+        template <size_t N>
+        constexpr EffectDef<N * 4> synth(const Chunk (&chunks)[N], const uint8_t repeat = 1)
+        {
+            EffectDef<N * 4> e {PlayMode::Synthesis, repeat, {}};
+            for (size_t i = 0; i < N; ++i)
+            {
+                if (chunks[i].freq == 0) synth_frequency_must_not_be_zero();
+                e.data[i * 4 + 0] = chunks[i].amp;
+                e.data[i * 4 + 1] = chunks[i].freq;
+                e.data[i * 4 + 2] = chunks[i].cycle;
+                e.data[i * 4 + 3] = chunks[i].envelop;
+            }
+            return e;
+        }
+
+        template <size_t N>
+        constexpr EffectDef<N> waveform(const uint8_t (&samples)[N], const uint8_t repeat = 1)
+        {
+            EffectDef<N> e {PlayMode::Direct, repeat, {}};
+            for (size_t i = 0; i < N; ++i) e.data[i] = samples[i];
+            return e;
+        }
+
+        // exact RAM contents from address 0x000 : header size, 5-byte headers, payloads
+        template <uint16_t SIZE>
+        struct RamImage
+        {
+            static_assert(SIZE <= 2048, "effect library does not fit into 2 KB DRV2667 RAM");
+
+            uint8_t bytes[SIZE];
+            uint8_t effects;
+
+            constexpr const uint8_t* data() const { return bytes; }
+            constexpr uint16_t size() const { return SIZE; }
+        };
+
+        namespace detail
+        {
+            // first address from addr where n bytes fit without covering a page register
+            constexpr uint16_t fit(const uint16_t addr, const uint16_t n)
+            {
+                return (addr % 256 + n - 1 < 0xFF) ? addr : uint16_t(addr - addr % 256 + 256);
+            }
+
+            // end of the laid out image
+            template <uint16_t... BYTES>
+            constexpr uint32_t imageSize()
+            {
+                const uint16_t sizes[] = {BYTES...};
+                uint32_t pos = 1 + 5 * sizeof...(BYTES);
+                for (const uint16_t n : sizes)
+                    if (pos < 2048) pos = fit(uint16_t(pos), n) + n;
+                return pos;
+            }
+            template <uint16_t... BYTES>
+            constexpr uint16_t largestEffect()
+            {
+                const uint16_t sizes[] = {BYTES...};
+                uint16_t m = 0;
+                for (const uint16_t n : sizes)
+                    if (n > m) m = n;
+                return m;
+            }
+
+            template <uint16_t SIZE, uint16_t BYTES>
+            constexpr int place(RamImage<SIZE>& img, uint8_t& id, uint16_t& addr, const EffectDef<BYTES>& e)
+            {
+                if (BYTES == 0) effect_must_not_be_empty();
+
+                addr = fit(addr, BYTES);
+                const uint16_t stop = addr + BYTES - 1;
+                const uint16_t h = 0x01 + 5 * id;
+                img.bytes[h + 0] = uint8_t(((e.mode == PlayMode::Synthesis) ? 0x80 : 0x00) | ((addr >> 8) & 0x07));
+                img.bytes[h + 1] = uint8_t(addr & 0x00FF);
+                img.bytes[h + 2] = uint8_t((stop >> 8) & 0x07);
+                img.bytes[h + 3] = uint8_t(stop & 0x00FF);
+                img.bytes[h + 4] = e.repeat; // 0x00 means repeat endlessly
+                for (uint16_t i = 0; i < BYTES; ++i) img.bytes[addr + i] = e.data[i];
+
+                ++id;
+                addr += BYTES;
+                return 0;
+            }
+        }
+
+        template <uint16_t... BYTES>
+        constexpr RamImage<uint16_t(detail::imageSize<BYTES...>())>
+        makeRamImage(const EffectDef<BYTES>&... effects)
+        {
+            static_assert(sizeof...(BYTES) > 0, "effect library is empty");
+            static_assert(sizeof...(BYTES) <= 50, "DRV2667 header table holds at most 50 effects");
+            static_assert(detail::largestEffect<BYTES...>() <= 255, "effect does not fit into one RAM page (255 bytes)");
+            static_assert(detail::imageSize<BYTES...>() <= 2048, "effect library does not fit into 2 KB DRV2667 RAM");
+
+            RamImage<uint16_t(detail::imageSize<BYTES...>())> img {{}, sizeof...(BYTES)};
+            img.bytes[0] = uint8_t(5 * sizeof...(BYTES));
+
+            uint8_t id = 0;
+            uint16_t addr = uint16_t(1 + 5 * sizeof...(BYTES));
+            int expand[] = {detail::place(img, id, addr, effects)...};
+            (void)expand;
+            return img;
+        }
+    }
+}
+
+#endif // __cplusplus >= 201402L
+
+#endif // DRV2667_RAMIMAGE_H
@@ -0,0 +1,203 @@
+#pragma once
+#ifndef DRV2667_RECOVERY_H
+#define DRV2667_RECOVERY_H
+
+        // Read-back verification and repair : the control registers and the RAM are burst read and compared
+        // with the register cache and the host image, and only the regions which differ are written again,
+        // each repair confirmed by reading it back (up to a bounded number of passes).
+        // Use it after a brown-out / reset of the chip or when drv.hasFault() reports a failed transaction :
+        // a RAM found cleared is rewritten at once, without reading the rest of it.
+        // Offset 0xFF of every RAM page is the page register and is never compared.
+
+namespace EmbeddedDevices
+{
+    namespace DRV2667
+    {
+        class Recovery
+        {
+            static const uint16_t RAM_PAGE_BYTES = 256;
+            static const uint8_t PAGE_REG = 0xFF;
+
+        public:
+
+            static const uint8_t MAX_SPANS = 16;
+            static const uint8_t MERGE_GAP = 4; // closer divergent regions are rewritten as one burst
+
+            struct Report
+            {
+                uint16_t registers;      // registers found different (bit n : register n), restored
+                uint16_t bytes_read;     // RAM bytes read back
+                uint16_t bytes_restored; // RAM bytes written again
+                uint8_t spans;           // divergent RAM regions found by the first pass
+                uint8_t passes;          // RAM verify passes
+                bool cleared;            // RAM found empty (power cycle) and rewritten as a whole
+                bool ok;                 // registers and RAM match after recovery
+            };
+
+            explicit Recovery(DRV2667& drv, const uint8_t attempts = 3) : drv_(drv), attempts_(attempts ? attempts : 1) {}
+
+            void setAttempts(const uint8_t n) { attempts_ = n ? n : 1; }
+
+            // CRC-32 (as crc32()) of the first size bytes of an image / of the chip RAM, page register offsets excluded
+            static uint32_t checksum(const uint8_t* image, const uint16_t size)
+            {
+                uint32_t crc = 0;
+                for (uint16_t addr = 0; addr < size; addr = nextBlock(addr, size))
+                    crc = crc32(image + addr, blockEnd(addr, size) - addr, crc);
+                return crc;
+            }
+            bool checksumRAM(const uint16_t size, uint32_t& crc)
+            {
+                uint8_t buf[DRV2667_I2C_BUFFER_LENGTH];
+                crc = 0;
+                for (uint16_t addr = 0; addr < size; addr = nextBlock(addr, size))
+                {
+                    const uint16_t n = blockEnd(addr, size) - addr;
+                    if (drv_.readRAM(addr, buf, n) != n) return false;
+                    crc = crc32(buf, n, crc);
+                }
+                return true;
+            }
+
+            // compare RAM [0, size) with image, divergent regions in span(); true if they match
+            bool verifyRAM(const uint8_t* image, const uint16_t size)
+            {
+                count_ = 0;
+                scan(image, 0, size);
+                return count_ == 0;
+            }
+            uint8_t spans() const { return count_; }
+            const Span& span(const uint8_t i) const { return spans_[i]; }
+
+            // rewrite the divergent regions and read them back until they match or attempts run out
+            bool restoreRAM(const uint8_t* image, const uint16_t size)
+            {
+                if (verifyRAM(image, size)) return true;
+                report_.spans = count_;
+                return repair(image);
+            }
+
+            // registers (restored from the cache) and RAM (restored from image)
+            const Report& recover(const uint8_t* image, const uint16_t size)
+            {
+                report_ = Report {};
+                drv_.clearFault();
+                drv_.invalidateRegisters(); // the page may have been reset under the cache
+
+                uint16_t diff = 0xFFFF;
+                for (uint8_t i = 0; i < attempts_ && diff == 0xFFFF; ++i) diff = drv_.verifyRegisters();
+                if (diff == 0xFFFF) return report_;
+                report_.registers = diff;
+                if (diff) drv_.restoreRegisters(diff);
+
+                bool ok = true;
+                if (size)
+                {
+                    // an empty header table where the image has effects : RAM was lost, skip the read back
+                    uint8_t head = 0;
+                    uint8_t i = 0;
+                    while (drv_.readRAM(0, &head, 1) != 1)
+                        if (++i == attempts_) return report_;
+                    ++report_.bytes_read;
+                    if (head == 0 && image[0] != 0)
+                    {
+                        report_.cleared = true;
+                        count_ = 1;
+                        spans_[0] = Span {0, size};
+                        ok = repair(image);
+                    }
+                    else
+                        ok = restoreRAM(image, size);
+                }
+                if (diff) ok = ok && (drv_.verifyRegisters() == 0);
+                report_.ok = ok;
+                if (ok) drv_.clearFault(); // errors on the way were retried and verified
+                return report_;
+            }
+
+            // against the driver's own effects image
+            const Report& recover()
+            {
+                const Effects& effects = drv_.getEffects();
+                return recover(effects.image(), effects.getImageSize());
+            }
+
+            const Report& report() const { return report_; }
+
+        private:
+
+            // [addr, blockEnd) is one burst read : it never crosses a page or its page register
+            static uint16_t blockEnd(const uint16_t addr, const uint16_t size)
+            {
+                uint16_t end = addr - (addr % RAM_PAGE_BYTES) + PAGE_REG;
+                if (end > addr + DRV2667_I2C_BUFFER_LENGTH) end = addr + DRV2667_I2C_BUFFER_LENGTH;
+                return (end < size) ? end : size;
+            }
+            static uint16_t nextBlock(const uint16_t addr, const uint16_t size)
+            {
+                const uint16_t end = blockEnd(addr, size);
+                if (end == size) return size;
+                return (end % RAM_PAGE_BYTES == PAGE_REG) ? end + 1 : end;
+            }
+
+            // append divergent regions of [begin, end); bytes which could not be read count as divergent
+            void scan(const uint8_t* image, const uint16_t begin, const uint16_t end)
+            {
+                uint8_t buf[DRV2667_I2C_BUFFER_LENGTH];
+                for (uint16_t addr = begin; addr < end; addr = nextBlock(addr, end))
+                {
+                    if (addr % RAM_PAGE_BYTES == PAGE_REG) continue;
+                    const uint16_t n = blockEnd(addr, end) - addr;
+                    uint16_t received = drv_.readRAM(addr, buf, n);
+                    if (received > n) received = n;
+                    report_.bytes_read += received;
+                    for (uint16_t i = 0; i < n; ++i)
+                        if (i >= received || buf[i] != image[addr + i]) mark(addr + i);
+                }
+            }
+
+            void mark(const uint16_t addr)
+            {
+                if (count_ && addr <= spans_[count_ - 1].end + MERGE_GAP)
+                {
+                    spans_[count_ - 1].end = addr + 1;
+                    return;
+                }
+                if (count_ == MAX_SPANS) // out of slots : widen the last one
+                {
+                    spans_[count_ - 1].end = addr + 1;
+                    return;
+                }
+                spans_[count_++] = Span {addr, uint16_t(addr + 1)};
+            }
+
+            // write the spans, then read back only those; repeat with what still differs
+            bool repair(const uint8_t* image)
+            {
+                for (uint8_t pass = 0; pass < attempts_ && count_; ++pass)
+                {
+                    ++report_.passes;
+                    Span pending[MAX_SPANS];
+                    const uint8_t n = count_;
+                    for (uint8_t i = 0; i < n; ++i)
+                    {
+                        pending[i] = spans_[i];
+                        drv_.writeRAM(pending[i].begin, image + pending[i].begin, pending[i].end - pending[i].begin);
+                        report_.bytes_restored += pending[i].end - pending[i].begin;
+                    }
+                    count_ = 0;
+                    for (uint8_t i = 0; i < n; ++i) scan(image, pending[i].begin, pending[i].end);
+                }
+                return count_ == 0;
+            }
+
+            DRV2667& drv_;
+            uint8_t attempts_;
+            Span spans_[MAX_SPANS];
+            uint8_t count_ {0};
+            Report report_ {};
+        };
+    }
+}
+
+#endif // DRV2667_RECOVERY_H
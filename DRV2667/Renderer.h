@@ -0,0 +1,217 @@
+#pragma once
+#ifndef DRV2667_RENDERER_H
+#define DRV2667_RENDERER_H
+
+        // Software model of the DRV2667 playback engine : renders a RAM image (header table and effect data)
+        // and a sequence into the 8 kHz two's complement sample stream, in the same format as direct playback
+        // data and FIFO samples (e.g. to feed FifoStream, for previews or to compare effect libraries).
+        //
+        // The synthesizer is modelled after the datasheet : 16 bit phase accumulator advancing freq x 64 per
+        // sample (7.8125 Hz steps), chunks end after `cycle` full periods, linear ramp-up inside and ramp-down
+        // after the programmed duration, repeat count 0 plays forever.
+        // Rendering is incremental : render() continues where the previous call stopped.
+
+#include <math.h>
+
+namespace EmbeddedDevices
+{
+    namespace DRV2667
+    {
+        class Renderer
+        {
+            static const uint8_t HEADER_BYTES = 5;
+
+        public:
+
+            Renderer(const uint8_t* image, const uint16_t size)
+            : image_(image)
+            , size_(size)
+            {}
+
+            template <uint8_t MAX_EFFECTS, uint16_t RAM_BYTES>
+            explicit Renderer(const BasicEffects<MAX_EFFECTS, RAM_BYTES>& effects)
+            : Renderer(effects.image(), effects.getImageSize())
+            {}
+
+            // number of effects in the header table
+            const uint8_t effects() const { return (size_ && image_[0] <= size_) ? image_[0] / HEADER_BYTES : 0; }
+
+            // play ids in order as go() does with the sequencer registers, id 0 ends the sequence
+            bool start(const Sequence& seq)
+            {
+                for (uint8_t i = 0; i < SEQUENCE_SIZE; ++i) seq_[i] = seq.ids[i];
+                slot_ = 0;
+                done_ = !begin(seq_[0]);
+                return !done_;
+            }
+            // one effect alone (id : 1 - effects())
+            bool start(const uint8_t id)
+            {
+                Sequence seq {{id}};
+                return start(seq);
+            }
+
+            // render up to size samples, returns the number of samples written (< size : playback ended)
+            uint32_t render(uint8_t* out, const uint32_t size)
+            {
+                uint32_t n = 0;
+                while (n < size && !done_)
+                {
+                    if (synth_)
+                    {
+                        uint32_t m = total_ - k_;
+                        if (m > size - n) m = size - n;
+                        synthesize(out + n, m);
+                        k_ += m;
+                        n += m;
+                        produced_ += m;
+                        if (k_ >= total_) nextChunk();
+                    }
+                    else
+                    {
+                        uint32_t m = stop_ + 1 - pos_;
+                        if (m > size - n) m = size - n;
+                        for (uint32_t i = 0; i < m; ++i) out[n + i] = image_[pos_ + i];
+                        pos_ += m;
+                        n += m;
+                        produced_ += m;
+                        if (pos_ > stop_) nextPass();
+                    }
+                }
+                return n;
+            }
+
+            bool done() const { return done_; }
+
+            // samples of one pass of effect id (repeats not included), 0 for invalid ids
+            uint32_t length(const uint8_t id) const
+            {
+                uint16_t start = 0, stop = 0;
+                bool synth = false;
+                if (!header(id, start, stop, synth)) return 0;
+                if (!synth) return stop + 1 - start;
+                uint32_t n = 0;
+                for (uint16_t a = start; a + 3 <= stop; a += 4)
+                    n += chunkSamples(Chunk {image_[a], image_[a + 1], image_[a + 2], image_[a + 3]});
+                return n;
+            }
+
+            const uint8_t getRepeatCount(const uint8_t id) const
+            {
+                return (id >= 1 && id <= effects()) ? image_[1 + (id - 1) * HEADER_BYTES + 4] : 0;
+            }
+
+        private:
+
+            static const uint8_t SEQUENCE_SIZE = 8;
+
+            // one period of the sine at full scale, indexed by the upper 8 bits of the phase
+            static const int8_t* sine()
+            {
+                struct Table
+                {
+                    int8_t v[256];
+                    Table() { for (uint16_t i = 0; i < 256; ++i) v[i] = (int8_t)lround(127. * sin(2. * M_PI * i / 256.)); }
+                };
+                static const Table table;
+                return table.v;
+            }
+
+            bool header(const uint8_t id, uint16_t& start, uint16_t& stop, bool& synth) const
+            {
+                if (id == 0 || id > effects()) return false;
+                const uint8_t* h = image_ + 1 + (id - 1) * HEADER_BYTES;
+                synth = (h[0] & 0x80);
+                start = (uint16_t)(((h[0] & 0x07) << 8) | h[1]);
+                stop = (uint16_t)(((h[2] & 0x07) << 8) | h[3]);
+                return start <= stop && stop < size_ && (!synth || stop - start >= 3);
+            }
+
+            // start effect id from its first byte, false if it is invalid
+            bool begin(const uint8_t id)
+            {
+                if (!header(id, start_, stop_, synth_)) return false;
+                id_ = id;
+                repeat_ = getRepeatCount(id);
+                pos_ = start_;
+                produced_ = 0;
+                if (synth_) loadChunk();
+                return true;
+            }
+
+            // end of one pass : repeat, or the next id of the sequence
+            void nextPass()
+            {
+                const bool silent = (produced_ == 0); // e.g. only invalid chunks : would repeat forever
+                if (!silent && (repeat_ == 0 || --repeat_ > 0))
+                {
+                    const uint8_t left = repeat_;
+                    begin(id_);
+                    repeat_ = left;
+                    return;
+                }
+                if (++slot_ >= SEQUENCE_SIZE) done_ = true;
+                else                          done_ = !begin(seq_[slot_]);
+            }
+
+            void loadChunk()
+            {
+                const Chunk c {image_[pos_], image_[pos_ + 1], image_[pos_ + 2], image_[pos_ + 3]};
+                amp_ = c.amp;
+                step_ = phaseStep(c.freq);
+                body_ = cycleSamples(c.freq, c.cycle);
+                up_ = rampSamples(c.envelop >> 4, c.amp);
+                if (up_ > body_) up_ = body_;
+                down_ = rampSamples(c.envelop, c.amp);
+                total_ = (c.freq == 0) ? 0 : body_ + down_; // frequency 0 is not allowed : chunk skipped
+                k_ = 0;
+            }
+
+            void nextChunk()
+            {
+                pos_ += 4;
+                if (pos_ + 3 > stop_) nextPass();
+                else                  loadChunk();
+            }
+
+            // samples k_ to k_ + m of the current chunk, one loop per envelope segment
+            void synthesize(uint8_t* out, const uint32_t m)
+            {
+                const int8_t* lut = sine();
+                const uint32_t end = k_ + m;
+                uint32_t k = k_;
+                for (; k < end && k < up_; ++k)
+                    *out++ = (uint8_t)(int8_t)(lut[((k * step_) >> 8) & 0xFF] * (int32_t)(amp_ * k / up_) / 255);
+                for (; k < end && k < body_; ++k)
+                    *out++ = (uint8_t)(int8_t)(lut[((k * step_) >> 8) & 0xFF] * (int32_t)amp_ / 255);
+                for (; k < end; ++k)
+                    *out++ = (uint8_t)(int8_t)(lut[((k * step_) >> 8) & 0xFF] * (int32_t)(amp_ * (total_ - k) / down_) / 255);
+            }
+
+            const uint8_t* image_;
+            uint16_t size_;
+
+            uint8_t seq_[SEQUENCE_SIZE] {};
+            uint8_t slot_ {0};
+            uint8_t id_ {0};
+            uint8_t repeat_ {0};
+            bool done_ {true};
+
+            bool synth_ {false};
+            uint16_t start_ {0};
+            uint16_t stop_ {0};
+            uint16_t pos_ {0};
+            uint32_t produced_ {0}; // samples of the current pass
+
+            uint8_t amp_ {0};
+            uint32_t step_ {0};
+            uint32_t body_ {0};
+            uint32_t up_ {0};
+            uint32_t down_ {0};
+            uint32_t total_ {0};
+            uint32_t k_ {0};
+        };
+    }
+}
+
+#endif // DRV2667_RENDERER_H
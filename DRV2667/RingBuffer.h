@@ -0,0 +1,95 @@
+#pragma once
+#ifndef DRV2667_RINGBUFFER_H
+#define DRV2667_RINGBUFFER_H
+
+#ifndef __AVR__
+#include <atomic>
+#endif
+
+namespace EmbeddedDevices
+{
+    namespace DRV2667
+    {
+        // single-producer / single-consumer lock-free ring buffer
+        // producer only writes head_, consumer only writes tail_ ; one slot is kept empty
+        template <typename T, uint16_t N>
+        class RingBuffer
+        {
+#ifdef __AVR__
+            static_assert(N <= 256, "RingBuffer on AVR is limited to 256 slots (single byte index)");
+            using Index = uint8_t; // single byte loads and stores are atomic on AVR
+            using AtomicIndex = volatile uint8_t;
+            static Index load(const AtomicIndex& i) { return i; }
+            static void store(AtomicIndex& i, const Index v) { i = v; }
+#else
+            using Index = uint16_t;
+            using AtomicIndex = std::atomic<uint16_t>;
+            static Index load(const AtomicIndex& i) { return i.load(std::memory_order_acquire); }
+            static void store(AtomicIndex& i, const Index v) { i.store(v, std::memory_order_release); }
+#endif
+            static_assert(N >= 2, "RingBuffer needs at least 2 slots");
+
+        public:
+
+            static const uint16_t CAPACITY = N - 1;
+
+            // producer side
+
+            bool push(const T& v)
+            {
+                const Index h = load(head_);
+                const Index next = (h + 1 == N) ? 0 : h + 1;
+                if (next == load(tail_)) return false; // full
+                buf_[h] = v;
+                store(head_, next);
+                return true;
+            }
+
+            uint16_t push(const T* data, const uint16_t size)
+            {
+                uint16_t n = 0;
+                while (n < size && push(data[n])) ++n;
+                return n;
+            }
+
+            uint16_t available() const { return CAPACITY - size(); }
+
+            // consumer side
+
+            bool pop(T& v)
+            {
+                const Index t = load(tail_);
+                if (t == load(head_)) return false; // empty
+                v = buf_[t];
+                store(tail_, (t + 1 == N) ? 0 : t + 1);
+                return true;
+            }
+
+            uint16_t pop(T* data, const uint16_t size)
+            {
+                uint16_t n = 0;
+                while (n < size && pop(data[n])) ++n;
+                return n;
+            }
+
+            // either side
+
+            uint16_t size() const
+            {
+                const Index h = load(head_);
+                const Index t = load(tail_);
+                return (h >= t) ? (h - t) : (N - t + h);
+            }
+            bool empty() const { return size() == 0; }
+            bool full() const { return size() == CAPACITY; }
+
+        private:
+
+            T buf_[N];
+            AtomicIndex head_ {0};
+            AtomicIndex tail_ {0};
+        };
+    }
+}
+
+#endif // DRV2667_RINGBUFFER_H
@@ -0,0 +1,118 @@
+#pragma once
+#ifndef DRV2667_SCHEDULER_H
+#define DRV2667_SCHEDULER_H
+
+        // Playback without busy retriggering : the duration of a sequence is computed from the effects
+        // (chunks, cycles, frequency, ramps and repeat counts), so go() is only sent when a sequence is started
+        // or has ended, and the bus is untouched while the chip plays.
+        // When the computed end is reached, the GO bit is read back once to confirm it (and then every
+        // POLL_INTERVAL_US while the chip is still busy), unless confirmation is disabled.
+
+namespace EmbeddedDevices
+{
+    namespace DRV2667
+    {
+        // called from update() when a sequence started with play() has finished
+        using Finished = void (*)(const Sequence& seq, void* context);
+
+        class Scheduler
+        {
+        public:
+
+            static const uint32_t POLL_INTERVAL_US = 1000;
+
+            explicit Scheduler(DRV2667& drv) : drv_(drv) {}
+
+            // play seq once, cb is called from update() when it has finished
+            // returns the expected duration in us (0xFFFFFFFF : repeats forever or too long to time)
+            uint32_t play(const Sequence& seq, Finished cb = nullptr, void* ctx = nullptr)
+            {
+                cb_ = cb;
+                ctx_ = ctx;
+                looping_ = false;
+                return start(seq, true);
+            }
+
+            // keep seq playing : go() is sent again only when the previous pass has ended
+            // a sequence of zero duration (no playable effect) is played once and finishes like play()
+            uint32_t loop(const Sequence& seq)
+            {
+                cb_ = nullptr;
+                looping_ = true;
+                return start(seq, true);
+            }
+
+            void stop()
+            {
+                if (!active_) return;
+                drv_.stop();
+                active_ = false;
+            }
+
+            // call periodically (loop(), task), I2C is only used once the computed end is reached
+            void update()
+            {
+                if (!active_ || duration_us_ == 0xFFFFFFFF) return;
+                if ((int32_t)(micros() - deadline_us_) < 0) return;
+
+                if (confirm_ && drv_.isPlaying())
+                {
+                    deadline_us_ = micros() + POLL_INTERVAL_US;
+                    return;
+                }
+
+                if (looping_ && duration_us_ != 0)
+                {
+                    start(seq_, false);
+                    return;
+                }
+                active_ = false;
+                if (cb_) cb_(seq_, ctx_);
+            }
+
+            bool isActive() const { return active_; }
+            bool isLooping() const { return active_ && looping_; }
+
+            // time until the computed end, 0xFFFFFFFF if it never ends
+            uint32_t remaining() const
+            {
+                if (!active_) return 0;
+                if (duration_us_ == 0xFFFFFFFF) return 0xFFFFFFFF;
+                const int32_t left = (int32_t)(deadline_us_ - micros());
+                return (left > 0) ? (uint32_t)left : 0;
+            }
+            uint32_t getDuration() const { return duration_us_; }
+
+            // true (default) : confirm the end by reading GO, false : trust the timing model only
+            void confirmWithGO(const bool b) { confirm_ = b; }
+
+        private:
+
+            uint32_t start(const Sequence& seq, const bool write_sequence)
+            {
+                seq_ = seq;
+                drv_.flush();
+                if (write_sequence) drv_.play(seq); // only changed sequencer slots are written
+                else                drv_.go();
+                // effects may have been modulated since the last pass
+                duration_us_ = drv_.getEffects().getDurationUs(seq);
+                if (duration_us_ >= 0x7FFFFFFF && duration_us_ != 0xFFFFFFFF) duration_us_ = 0xFFFFFFFF;
+                deadline_us_ = micros() + duration_us_;
+                active_ = (drv_.getI2CStatus() == 0);
+                return duration_us_;
+            }
+
+            DRV2667& drv_;
+            Sequence seq_ {};
+            Finished cb_ {nullptr};
+            void* ctx_ {nullptr};
+            bool looping_ {false};
+            bool active_ {false};
+            bool confirm_ {true};
+            uint32_t duration_us_ {0};
+            uint32_t deadline_us_ {0};
+        };
+    }
+}
+
+#endif // DRV2667_SCHEDULER_H
@@ -0,0 +1,290 @@
+#pragma once
+#ifndef DRV2667_TRANSACTIONQUEUE_H
+#define DRV2667_TRANSACTIONQUEUE_H
+
+        // Non-blocking access to the DRV2667 : requests are queued and poll() performs at most one
+        // I2C transaction per call, so the caller is never blocked for longer than one burst.
+        // Large RAM uploads are split into bursts lazily, therefore a high priority request
+        // (e.g. go()) is served between two bursts of a bulk upload.
+        //
+        // poll() can be called from loop(), an RTOS task or a timer callback which is allowed to use Wire.
+        // If requests are enqueued from a different context than poll(), define DRV2667_QUEUE_LOCK()
+        // and DRV2667_QUEUE_UNLOCK() (e.g. noInterrupts() / interrupts(), or a mutex).
+
+#ifndef DRV2667_QUEUE_LOCK
+    #define DRV2667_QUEUE_LOCK()
+#endif
+#ifndef DRV2667_QUEUE_UNLOCK
+    #define DRV2667_QUEUE_UNLOCK()
+#endif
+
+namespace EmbeddedDevices
+{
+    namespace DRV2667
+    {
+        enum class Priority : uint8_t { Low, Normal, High };
+
+        // 0 : invalid (queue was full)
+        using Handle = uint16_t;
+
+        // called from poll() when a request completed, status as DRV2667::getI2CStatus()
+        using Completion = void (*)(const Handle handle, const uint8_t status, void* context);
+
+        template <uint8_t N = 16>
+        class TransactionQueue
+        {
+            static_assert(N > 0 && N < 128, "TransactionQueue size must be 1 - 127");
+
+        public:
+
+            static const uint8_t INLINE_BYTES = 8;
+
+            explicit TransactionQueue(DRV2667& drv) : drv_(drv) {}
+
+            // write control registers from reg, data is copied when it fits INLINE_BYTES
+            // otherwise it has to stay valid until completion
+            Handle write(const uint8_t reg, const uint8_t* data, const uint16_t size,
+                         const Priority p = Priority::Normal, Completion cb = nullptr, void* ctx = nullptr)
+            {
+                return push(Kind::Register, reg, const_cast<uint8_t*>(data), size, p, cb, ctx);
+            }
+            Handle write(const uint8_t reg, const uint8_t data,
+                         const Priority p = Priority::Normal, Completion cb = nullptr, void* ctx = nullptr)
+            {
+                return push(Kind::Register, reg, const_cast<uint8_t*>(&data), 1, p, cb, ctx);
+            }
+
+            // write linear RAM address (0x000 - 0x7FF), page switching is handled per burst
+            Handle writeRAM(const uint16_t addr, const uint8_t* data, const uint16_t size,
+                            const Priority p = Priority::Low, Completion cb = nullptr, void* ctx = nullptr)
+            {
+                return push(Kind::RAM, addr, const_cast<uint8_t*>(data), size, p, cb, ctx);
+            }
+
+            // upload a prebuilt RAM image (e.g. makeRamImage()) which has to stay valid until completion
+            template <typename Image>
+            Handle upload(const Image& image, const Priority p = Priority::Low, Completion cb = nullptr, void* ctx = nullptr)
+            {
+                return writeRAM(0x000, image.data(), image.size(), p, cb, ctx);
+            }
+
+            // queue the dirty spans of the driver's effects image, returns handle of the last span
+            // the image is read when each burst is sent, so later edits are picked up as well; each range
+            // stays dirty until its burst succeeded. cb is called once, after the last span, with the worst
+            // status of all spans. 0 while a previous sync is in flight (edits stay dirty for the next call)
+            Handle syncEffects(const Priority p = Priority::Low, Completion cb = nullptr, void* ctx = nullptr)
+            {
+                if (!drv_.hasEffects()) return 0;
+                Effects& effects = drv_.getEffects();
+                if (!effects.isDirty() || sync_left_) return 0;
+                if (N - count_ < effects.dirtySpans()) return 0;
+
+                Handle h = 0;
+                for (uint8_t i = 0; i < effects.dirtySpans(); ++i)
+                {
+                    const Span& span = effects.dirtySpan(i);
+                    h = push(Kind::Effects, span.begin, const_cast<uint8_t*>(effects.image() + span.begin),
+                             span.end - span.begin, p, nullptr, nullptr);
+                }
+                sync_left_ = effects.dirtySpans();
+                sync_status_ = 0;
+                sync_handle_ = h;
+                sync_cb_ = cb;
+                sync_ctx_ = ctx;
+                return h;
+            }
+
+            // read control registers from reg into data, which has to stay valid until completion
+            Handle read(const uint8_t reg, uint8_t* data, const uint16_t size,
+                        const Priority p = Priority::Normal, Completion cb = nullptr, void* ctx = nullptr)
+            {
+                return push(Kind::Read, reg, data, size, p, cb, ctx);
+            }
+
+            // trigger playback through DRV2667::go()
+            Handle go(const Priority p = Priority::High, Completion cb = nullptr, void* ctx = nullptr)
+            {
+                return push(Kind::Go, 0x02, nullptr, 0, p, cb, ctx);
+            }
+
+            // perform one I2C transaction of the most urgent request
+            // returns false if nothing was pending
+            bool poll()
+            {
+                DRV2667_QUEUE_LOCK();
+                const int8_t i = next();
+                if (i < 0)
+                {
+                    DRV2667_QUEUE_UNLOCK();
+                    return false;
+                }
+                Request r = queue_[i]; // work on a copy, the slot is kept busy
+                DRV2667_QUEUE_UNLOCK();
+
+                const uint8_t* src = (r.external ? r.data : r.inline_data) + r.done;
+                uint16_t n = r.size - r.done;
+                if (n > drv_.getBurstSize()) n = drv_.getBurstSize();
+
+                switch (r.kind)
+                {
+                    case Kind::Register:
+                    {
+                        drv_.writeRegisters(uint8_t(r.addr + r.done), src, n); // keeps the register cache in step
+                        break;
+                    }
+                    case Kind::RAM:
+                    case Kind::Effects:
+                    {
+                        const uint16_t a = r.addr + r.done;
+                        const uint16_t room = 0x100 - (a & 0xFF);
+                        if (n > room) n = room; // one page per burst (0xFF, the page register, is skipped)
+                        drv_.writeRAM(a, src, n);
+                        if (r.kind == Kind::Effects && drv_.getI2CStatus() == 0 && !drv_.sharesEffects())
+                            drv_.getEffects().clearDirty(a, a + n); // a shared store stays dirty for the other devices
+                        break;
+                    }
+                    case Kind::Read:
+                    {
+                        drv_.setMemoryPage(0x00);
+                        if (drv_.read(uint8_t(r.addr + r.done), r.data + r.done, n) < n && drv_.getI2CStatus() == 0)
+                            status_ = 4;
+                        break;
+                    }
+                    case Kind::Go:
+                    {
+                        drv_.go();
+                        break;
+                    }
+                }
+
+                const uint8_t status = (drv_.getI2CStatus() != 0) ? drv_.getI2CStatus() : status_;
+                status_ = 0;
+                r.done += n;
+
+                const bool finished = (status != 0) || (r.done >= r.size);
+                DRV2667_QUEUE_LOCK();
+                if (finished)
+                {
+                    queue_[i].used = false;
+                    --count_;
+                }
+                else
+                    queue_[i].done = r.done;
+                DRV2667_QUEUE_UNLOCK();
+
+                if (finished)
+                {
+                    last_status_ = status;
+                    if (r.cb) r.cb(r.handle, status, r.ctx);
+                    if (r.kind == Kind::Effects)
+                    {
+                        if (status > sync_status_) sync_status_ = status;
+                        if (--sync_left_ == 0 && sync_cb_) sync_cb_(sync_handle_, sync_status_, sync_ctx_);
+                    }
+                }
+                return true;
+            }
+
+            // poll until the queue is empty (blocking)
+            void drain() { while (poll()); }
+
+            bool isDone(const Handle h) const
+            {
+                for (uint8_t i = 0; i < N; ++i)
+                    if (queue_[i].used && queue_[i].handle == h) return false;
+                return true;
+            }
+
+            uint8_t pending() const { return count_; }
+            bool full() const { return count_ >= N; }
+            uint8_t getLastStatus() const { return last_status_; }
+
+        private:
+
+            enum class Kind : uint8_t { Register, RAM, Effects, Read, Go };
+
+            struct Request
+            {
+                Kind kind;
+                Priority priority;
+                bool used;
+                bool external;
+                uint16_t addr;
+                uint16_t size;
+                uint16_t done;
+                Handle handle;
+                uint8_t* data;
+                uint8_t inline_data[INLINE_BYTES];
+                Completion cb;
+                void* ctx;
+            };
+
+            Handle push(const Kind kind, const uint16_t addr, uint8_t* data, const uint16_t size,
+                        const Priority p, Completion cb, void* ctx)
+            {
+                DRV2667_QUEUE_LOCK();
+                int8_t slot = -1;
+                for (uint8_t i = 0; i < N; ++i)
+                    if (!queue_[i].used) { slot = i; break; }
+                if (slot < 0)
+                {
+                    DRV2667_QUEUE_UNLOCK();
+                    return 0;
+                }
+
+                Request& r = queue_[slot];
+                r.kind = kind;
+                r.priority = p;
+                r.addr = addr;
+                r.size = size;
+                r.done = 0;
+                r.cb = cb;
+                r.ctx = ctx;
+                r.data = data;
+                r.external = (kind == Kind::Read) || (kind == Kind::Effects) || (size > INLINE_BYTES);
+                if (!r.external)
+                    for (uint16_t i = 0; i < size; ++i) r.inline_data[i] = data[i];
+
+                if (++next_handle_ == 0) ++next_handle_;
+                r.handle = next_handle_;
+                r.used = true;
+                ++count_;
+                const Handle h = r.handle;
+                DRV2667_QUEUE_UNLOCK();
+                return h;
+            }
+
+            // highest priority first, then oldest first
+            int8_t next() const
+            {
+                int8_t best = -1;
+                for (uint8_t i = 0; i < N; ++i)
+                {
+                    if (!queue_[i].used) continue;
+                    if (best < 0) { best = i; continue; }
+                    const Request& a = queue_[i];
+                    const Request& b = queue_[best];
+                    if (a.priority > b.priority || (a.priority == b.priority && int16_t(a.handle - b.handle) < 0))
+                        best = i;
+                }
+                return best;
+            }
+
+            DRV2667& drv_;
+            Request queue_[N] {};
+            uint8_t count_ {0};
+            Handle next_handle_ {0};
+            uint8_t status_ {0};
+            uint8_t last_status_ {0};
+
+            // syncEffects() in flight
+            uint8_t sync_left_ {0};
+            uint8_t sync_status_ {0};
+            Handle sync_handle_ {0};
+            Completion sync_cb_ {nullptr};
+            void* sync_ctx_ {nullptr};
+        };
+    }
+}
+
+#endif // DRV2667_TRANSACTIONQUEUE_H
@@ -1,41 +1,52 @@
 #include "DRV2667.h"
 
+// ESP32 : square drive on DAC1 (GPIO 25) from a hardware timer, 8 kHz
+const uint8_t dac_pin = 25;
+const uint32_t sample_rate = 8000;
+
 DRV2667 drv;
+DRV2667AnalogStream<128> stream(drv, sample_rate); // 16 ms per buffer
+hw_timer_t* timer = NULL;
 
-const uint8_t dac_pin = 25;
+uint8_t square[64];
 uint8_t vol = 0;
 uint32_t prev_ms = 0;
 
-void dacSquare(int pin, uint8_t vol, float hz = 150.f)
+void IRAM_ATTR onTimer()
 {
-    static uint32_t prev_us = micros();
-    static bool is_dac_high = false;
-
-    uint32_t interval_us = (uint32_t)(1.f / hz * 1000000.f);
-    if ((micros() - prev_us) > interval_us)
-    {
-        is_dac_high = !is_dac_high;
-        prev_us = micros();
-    }
-    dacWrite(pin, (is_dac_high ? vol : 0));
+    dacWrite(dac_pin, stream.tick());
 }
 
 void setup()
 {
+    Serial.begin(115200);
     delay(1000);
 
-    drv.begin();
+    Wire.begin();
+    drv.attatch(Wire);
     drv.gain(DRV2667::Gain::D100V_A407dB);
-    drv.setToAnalogInput();
+
+    EmbeddedDevices::DRV2667::makeSquareTable(square, sizeof(square));
+    stream.play(DRV2667AnalogTable {square, sizeof(square)}, 150.f, vol);
+    stream.begin(); // analog input, both buffers filled
+
+    timer = timerBegin(0, 80, true); // 1 MHz
+    timerAttachInterrupt(timer, &onTimer, true);
+    timerAlarmWrite(timer, 1000000 / sample_rate, true);
+    timerAlarmEnable(timer);
 }
 
 void loop()
 {
+    stream.service(); // refills the buffer the timer has finished, at least every 16 ms
+
     if (millis() - prev_ms > 25)
     {
         ++vol;
+        stream.setLevel(vol); // from the next buffer on
+        if (vol == 0)   stream.gain(DRV2667::Gain::D100V_A407dB);
+        if (vol == 128) stream.gain(DRV2667::Gain::D50V_A348dB); // switched at a buffer boundary
         prev_ms = millis();
         Serial.println(vol);
     }
-    dacSquare(25, vol);
 }
@@ -0,0 +1,44 @@
+// drivers share the library of the array instead of carrying a 2 KB store each
+#define DRV2667_EMBED_EFFECTS 0
+#include "DRV2667.h"
+
+// 4 actuators behind a TCA9548A on Wire, 1 actuator directly on Wire1
+DRV2667EffectStore library;
+DRV2667 drv[5];
+DRV2667Mux mux(Wire, 0x70);
+DRV2667Array<5> actuators(library);
+
+DRV2667Synthesizer synth
+{{
+    {255, 0x15, 50, 0x09},
+    {255, 0x17, 50, 0x09},
+}};
+
+DRV2667Sequence pattern {{1}};
+
+void setup()
+{
+    Serial.begin(115200);
+    Wire.begin(21, 22);
+    Wire1.begin(25, 26);
+
+    for (uint8_t ch = 0; ch < 4; ++ch)
+        actuators.add(drv[ch], Wire, &mux, ch);
+    actuators.add(drv[4], Wire1);
+
+    // one shared library : built once, broadcast to every channel of the mux at once
+    library.append(synth);
+    actuators.syncEffects();
+
+    actuators.gain(DRV2667::Gain::D50V_A348dB);
+    actuators.setSequence(pattern);
+}
+
+void loop()
+{
+    actuators.go(); // one GO per bus
+    delay(1000);
+
+    actuators.go(0b00101); // actuator 0 and 2 only
+    delay(1000);
+}
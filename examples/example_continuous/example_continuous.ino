@@ -1,34 +1,24 @@
 #include "DRV2667.h"
 
 DRV2667 drv;
+DRV2667Scheduler scheduler(drv);
 
-#ifdef __AVR__
-struct EmbeddedDevices::DRV2667::SynthChunk synth[2]
-{
-    {255, 0x15, 50, 0x09},
-    {255, 0x17, 50, 0x09}
-};
-#else
-struct EmbeddedDevices::DRV2667::Synthesizer synth
-{
+DRV2667Synthesizer synth
+{{
     {255, 0x15, 10, 0},
     {255, 0x17, 50, 0}
-};
-#endif
+}};
 
 void setup()
 {
     Serial.begin(115200);
 
     Serial.println("DRV2667 test setup");
-    drv.begin();
+    Wire.begin();
+    drv.attatch(Wire);
     Serial.println("DRV2667 add synth");
 
-#ifdef __AVR__
-    drv.addSynthesizer(synth, 2);
-#else
     drv.addSynthesizer(synth);
-#endif
 
     Serial.println("set waveform");
     drv.setWaveformOrderAndID(0, 1); // in 0th order, play waveform id 1 (waveform id 0 means stop)
@@ -36,6 +26,8 @@ void setup()
     drv.gain(DRV2667::Gain::D25V_A288dB);
 
     Serial.println("DRV2667 test start");
+    // go() is sent again only when the effect has ended (duration computed from its chunks)
+    scheduler.loop(DRV2667Sequence {{1}});
 }
 
 uint8_t amp = 0;
@@ -48,8 +40,11 @@ void loop()
     {
         ++amp;
         drv.amp(0, 0, amp);
+        drv.flush(); // send all modulation of this frame at once
         prev_ms = millis();
-        Serial.println(amp);
+        Serial.print(amp);
+        Serial.print(" latency (us) : ");
+        Serial.println(drv.getUpdateLatency());
     }
-    drv.play();
+    scheduler.update();
 }
@@ -0,0 +1,57 @@
+#include "DRV2667.h"
+
+DRV2667 drv;
+DRV2667FifoStream<1024> stream(drv);
+
+// procedurally generated sweep, far longer than 2 KB RAM
+float phase = 0.f;
+float hz = 50.f;
+
+uint8_t nextSample()
+{
+    phase += hz / 8000.f;
+    if (phase >= 1.f) phase -= 1.f;
+    hz += 0.01f;
+    if (hz > 300.f) hz = 50.f;
+    return (uint8_t)(int8_t)(127.f * sinf(2.f * PI * phase));
+}
+
+void pumpTask(void*)
+{
+    while (true)
+    {
+        stream.pump();
+        vTaskDelay(pdMS_TO_TICKS(5)); // well within the 12 ms FIFO window
+    }
+}
+
+void setup()
+{
+    Serial.begin(115200);
+    Wire.begin(21, 22);
+    Wire.setClock(400000);
+    drv.attatch(Wire);
+    drv.gain(DRV2667::Gain::D100V_A407dB);
+
+    stream.begin();
+    xTaskCreatePinnedToCore(pumpTask, "drv2667", 4096, NULL, 2, NULL, 0);
+}
+
+uint32_t prev_ms = 0;
+
+void loop()
+{
+    while (stream.availableForWrite())
+        stream.write(nextSample());
+
+    if (millis() - prev_ms > 1000)
+    {
+        Serial.print("underflows : ");
+        Serial.print(stream.stats().underflows);
+        Serial.print(", overflows : ");
+        Serial.print(stream.stats().overflows);
+        Serial.print(", errors : ");
+        Serial.println(stream.stats().errors);
+        prev_ms = millis();
+    }
+}
@@ -0,0 +1,234 @@
+// bus-traffic benchmark against the simulated TwoWire
+// g++ -std=c++14 -O2 -I. -Iextras/host extras/bench/bench.cpp -o bench && ./bench [--csv]
+//
+// for each operation : I2C transactions, bytes on the wire (address bytes included),
+// estimated bus time at 100 / 400 / 1000 kHz and host CPU time per call
+
+#include "DRV2667.h"
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <stdlib.h>
+#include <string.h>
+
+namespace
+{
+    struct Result
+    {
+        uint32_t transactions;
+        uint32_t bytes;
+        double bus_us[3];
+        double cpu_us;
+    };
+
+    const uint32_t CLOCKS[3] {100000, 400000, 1000000};
+    const uint32_t CPU_REPEAT = 200;
+
+    bool csv = false;
+
+    void fresh()
+    {
+        Wire.device.powerOn();
+        Wire.clearLog();
+        Wire.setLogging(true);
+    }
+
+    std::unique_ptr<DRV2667> makeDriver()
+    {
+        std::unique_ptr<DRV2667> drv(new DRV2667());
+        drv->attatch(Wire);
+        return drv;
+    }
+
+    // a measurement has to run on the library it reports
+    void check(const bool ok, const char* what)
+    {
+        if (ok) return;
+        fprintf(stderr, "bench : %s failed\n", what);
+        exit(1);
+    }
+
+    // library of n effects : synth effects of `chunks` chunks, every 4th effect a waveform of `chunks` * 4 samples
+    // false if it does not fit into RAM
+    bool fill(EmbeddedDevices::DRV2667::Effects& effects, const uint8_t n, const uint8_t chunks)
+    {
+        EmbeddedDevices::DRV2667::Chunk c[16];
+        uint8_t samples[64];
+        for (uint8_t i = 0; i < n; ++i)
+        {
+            if (i % 4 == 3)
+            {
+                for (uint8_t j = 0; j < chunks * 4; ++j) samples[j] = uint8_t(i * 31 + j * 7);
+                if (!effects.append(samples, chunks * 4)) return false;
+            }
+            else
+            {
+                for (uint8_t j = 0; j < chunks; ++j) c[j] = {uint8_t(200 + i), uint8_t(0x10 + j), 20, 0x00};
+                if (!effects.append(c, chunks)) return false;
+            }
+        }
+        return true;
+    }
+    void fill(DRV2667& drv, const uint8_t n, const uint8_t chunks)
+    {
+        check(fill(drv.getEffects(), n, chunks), "fill");
+    }
+
+    // rows whose library does not fit are reported as such instead of being measured
+    bool fits(const uint8_t n, const uint8_t chunks)
+    {
+        EmbeddedDevices::DRV2667::Effects effects;
+        return fill(effects, n, chunks);
+    }
+
+    // setup() prepares a driver, op() is measured
+    Result measure(const std::function<void(DRV2667&)>& setup, const std::function<void(DRV2667&)>& op)
+    {
+        Result r {};
+
+        fresh();
+        auto drv = makeDriver();
+        setup(*drv);
+        Wire.clearLog();
+        op(*drv);
+        r.transactions = Wire.transactions();
+        for (const auto& t : Wire.log())
+        {
+            r.bytes += 1 + (uint32_t)t.bytes.size();
+            for (uint8_t k = 0; k < 3; ++k)
+                r.bus_us[k] += TwoWire::transactionTimeUs(1 + (uint32_t)t.bytes.size(), CLOCKS[k]);
+        }
+
+        // host CPU time, bus logging disabled
+        Wire.setLogging(false);
+        double total = 0.;
+        for (uint32_t i = 0; i < CPU_REPEAT; ++i)
+        {
+            auto d = makeDriver();
+            setup(*d);
+            const auto t0 = std::chrono::steady_clock::now();
+            op(*d);
+            const auto t1 = std::chrono::steady_clock::now();
+            total += std::chrono::duration<double, std::micro>(t1 - t0).count();
+        }
+        r.cpu_us = total / CPU_REPEAT;
+        return r;
+    }
+
+    void header()
+    {
+        if (csv)
+            printf("operation,effects,chunks,transactions,bytes,bus_us_100k,bus_us_400k,bus_us_1m,cpu_us\n");
+        else
+            printf("%-28s %7s %6s %8s %8s %11s %11s %11s %9s\n",
+                "operation", "effects", "chunks", "txns", "bytes", "100kHz[us]", "400kHz[us]", "1MHz[us]", "cpu[us]");
+    }
+
+    void skip(const char* name, const uint8_t effects, const uint8_t chunks)
+    {
+        if (csv)
+            printf("%s,%u,%u,does not fit,,,,,\n", name, effects, chunks);
+        else
+            printf("%-28s %7u %6u %8s\n", name, effects, chunks, "does not fit");
+    }
+
+    void report(const char* name, const uint8_t effects, const uint8_t chunks, const Result& r)
+    {
+        if (csv)
+            printf("%s,%u,%u,%u,%u,%.1f,%.1f,%.1f,%.3f\n", name, effects, chunks,
+                r.transactions, r.bytes, r.bus_us[0], r.bus_us[1], r.bus_us[2], r.cpu_us);
+        else
+            printf("%-28s %7u %6u %8u %8u %11.1f %11.1f %11.1f %9.3f\n", name, effects, chunks,
+                r.transactions, r.bytes, r.bus_us[0], r.bus_us[1], r.bus_us[2], r.cpu_us);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    for (int i = 1; i < argc; ++i)
+        if (strcmp(argv[i], "--csv") == 0) csv = true;
+
+    header();
+
+    const uint8_t sizes[] {1, 5, 10, 20, 35, 50};
+    const uint8_t chunk_counts[] {2, 8};
+
+    for (const uint8_t chunks : chunk_counts)
+    {
+        for (const uint8_t n : sizes)
+        {
+            if (!fits(n, chunks))
+            {
+                skip("setEffects (full upload)", n, chunks);
+                skip("append + syncEffects", n, chunks);
+                skip("amp + flush", n, chunks);
+                continue;
+            }
+
+            report("setEffects (full upload)", n, chunks, measure(
+                [&](DRV2667& d) { fill(d, n, chunks); },
+                [](DRV2667& d) { d.setEffects(); }));
+
+            report("append + syncEffects", n, chunks, measure(
+                [&](DRV2667& d) { fill(d, n - 1, chunks); d.setEffects(); },
+                [&](DRV2667& d) {
+                    EmbeddedDevices::DRV2667::Chunk c[16] {};
+                    for (uint8_t j = 0; j < chunks; ++j) c[j] = {255, 0x20, 10, 0x00};
+                    check(d.getEffects().append(c, chunks), "append");
+                    d.syncEffects();
+                }));
+
+            report("amp + flush", n, chunks, measure(
+                [&](DRV2667& d) { fill(d, n, chunks); d.setEffects(); d.play(); },
+                [](DRV2667& d) { d.amp(0, 0, 17); d.flush(); }));
+        }
+    }
+
+    report("setWaveformOrderAndID", 1, 0, measure(
+        [](DRV2667& d) { fill(d, 1, 2); d.setEffects(); },
+        [](DRV2667& d) { d.setWaveformOrderAndID(0, 1); }));
+
+    report("play(Sequence) (retrigger)", 1, 0, measure(
+        [](DRV2667& d) { fill(d, 3, 2); d.setEffects(); d.play(DRV2667Sequence {{1, 2, 3}}); },
+        [](DRV2667& d) { d.play(DRV2667Sequence {{3, 2, 1}}); }));
+
+    report("play (cold)", 1, 0, measure(
+        [](DRV2667& d) { fill(d, 1, 2); d.setEffects(); },
+        [](DRV2667& d) { d.play(); }));
+
+    report("play (awake)", 1, 0, measure(
+        [](DRV2667& d) { fill(d, 1, 2); d.setEffects(); d.play(); },
+        [](DRV2667& d) { d.play(); }));
+
+    report("gain (unchanged)", 1, 0, measure(
+        [](DRV2667& d) { d.gain(DRV2667::Gain::D50V_A348dB); },
+        [](DRV2667& d) { d.gain(DRV2667::Gain::D50V_A348dB); }));
+
+    // 1 s of continuous playback with a 1 ms loop()
+    report("1 s loop : play() every ms", 1, 2, measure(
+        [](DRV2667& d) { fill(d, 1, 2); d.setEffects(); d.play(); },
+        [](DRV2667& d) { for (uint16_t t = 0; t < 1000; ++t) { arduino_host::advance(1000); d.play(); } }));
+
+    report("1 s loop : Scheduler", 1, 2, measure(
+        [](DRV2667& d) { fill(d, 1, 2); d.setEffects(); },
+        [](DRV2667& d)
+        {
+            DRV2667Scheduler scheduler(d);
+            scheduler.loop(DRV2667Sequence {{1}});
+            for (uint16_t t = 0; t < 1000; ++t) { arduino_host::advance(1000); scheduler.update(); }
+        }));
+
+    // read-back verification of the largest library of 8 chunk effects which fits
+    uint8_t most = 50;
+    while (!fits(most, 8)) --most;
+
+    report("recover (intact)", most, 8, measure(
+        [&](DRV2667& d) { fill(d, most, 8); d.setEffects(); },
+        [](DRV2667& d) { DRV2667Recovery(d).recover(); }));
+
+    report("recover (power cycled)", most, 8, measure(
+        [&](DRV2667& d) { fill(d, most, 8); d.setEffects(); Wire.device.powerOn(); },
+        [](DRV2667& d) { DRV2667Recovery(d).recover(); }));
+
+    return 0;
+}
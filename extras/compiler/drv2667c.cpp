@@ -0,0 +1,95 @@
+// offline waveform compiler : PCM (.wav) or envelope (.csv) to a header usable with Effects
+// g++ -std=c++14 -O2 -I. extras/compiler/drv2667c.cpp -o drv2667c
+//
+// ./drv2667c input.wav  [-n name] [-o out.h] [-t tolerance] [-b budget] [-e effects] [--id first_effect_id]
+// ./drv2667c input.csv  [-n name] [-o out.h] [-s step_ms] [-b budget] [-e effects]
+//
+// the result fits when it needs at most `budget` RAM bytes and `effects` effects (default 8 : one sequence)
+//
+// .wav : 8 / 16 bit PCM, any sample rate (resampled to 8 kHz), channels are mixed down
+// .csv : one breakpoint per line "ms, amp (0 - 1), Hz", linear amplitude between points
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fstream>
+#include <iostream>
+#include "DRV2667/Compiler.h"
+
+using namespace EmbeddedDevices::DRV2667;
+
+namespace
+{
+    bool endsWith(const std::string& s, const char* ext)
+    {
+        const size_t n = strlen(ext);
+        return s.size() >= n && s.compare(s.size() - n, n, ext) == 0;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    std::string input, output, name = "effect";
+    compiler::Options opt;
+    float step_ms = 10.f;
+    int first_id = 1;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string a = argv[i];
+        const bool more = (i + 1 < argc);
+        if (a == "-n" && more) name = argv[++i];
+        else if (a == "-o" && more) output = argv[++i];
+        else if (a == "-t" && more) opt.tolerance = (float)atof(argv[++i]);
+        else if (a == "-b" && more) opt.budget = (uint16_t)atoi(argv[++i]);
+        else if (a == "-e" && more) opt.slots = (uint8_t)atoi(argv[++i]);
+        else if (a == "-s" && more) step_ms = (float)atof(argv[++i]);
+        else if (a == "--id" && more) first_id = atoi(argv[++i]);
+        else input = a;
+    }
+    if (input.empty())
+    {
+        std::cerr << "usage : drv2667c input.wav|input.csv [-n name] [-o out.h] [-t tolerance] [-b budget] [-e effects] [-s step_ms] [--id first]" << std::endl;
+        return 1;
+    }
+
+    compiler::Program prog;
+    if (endsWith(input, ".csv"))
+    {
+        std::vector<compiler::EnvelopePoint> env;
+        if (!compiler::readEnvelope(input, env))
+        {
+            std::cerr << "cannot read envelope " << input << std::endl;
+            return 1;
+        }
+        prog = compiler::compileEnvelope(env, step_ms, opt);
+    }
+    else
+    {
+        std::vector<float> pcm;
+        uint32_t rate = 0;
+        if (!compiler::readWav(input, pcm, rate))
+        {
+            std::cerr << "cannot read PCM wav " << input << std::endl;
+            return 1;
+        }
+        const std::vector<float> x = compiler::resample(pcm.data(), pcm.size(), rate);
+        prog = compiler::compilePCM(x.data(), x.size(), opt);
+        std::cerr << x.size() << " samples at 8 kHz (" << x.size() + 6 << " bytes as direct playback)" << std::endl;
+    }
+
+    for (size_t i = 0; i < prog.segments.size(); ++i)
+    {
+        const compiler::Segment& s = prog.segments[i];
+        std::cerr << "  " << name << "_" << i << " : "
+                  << ((s.mode == PlayMode::Synthesis) ? "synth  " : "direct ")
+                  << s.bytes.size() << " bytes, " << s.samples / 8.f << " ms, error " << s.error << std::endl;
+    }
+    std::cerr << prog.bytes() << " / " << opt.budget << " bytes of RAM, " << prog.segments.size() << " / " << (unsigned)opt.slots
+              << " effects" << (prog.fits ? "" : " : DOES NOT FIT") << std::endl;
+
+    const std::string header = compiler::emitHeader(prog, name, (uint8_t)first_id);
+    if (output.empty()) std::cout << header;
+    else std::ofstream(output) << header;
+    return prog.fits ? 0 : 2;
+}
@@ -0,0 +1,51 @@
+#pragma once
+#ifndef DRV2667_HOST_ARDUINO_H
+#define DRV2667_HOST_ARDUINO_H
+
+// minimal Arduino core for building the library on a host (Linux / macOS)
+// time is simulated : it only advances with delay() / delayMicroseconds() and simulated bus traffic
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <math.h>
+
+#ifndef PI
+#define PI 3.1415926535897932384626433832795
+#endif
+
+namespace arduino_host
+{
+    inline uint64_t& clock_us()
+    {
+        static uint64_t us = 0;
+        return us;
+    }
+    inline void advance(const uint64_t us) { clock_us() += us; }
+}
+
+inline unsigned long micros() { return (unsigned long)arduino_host::clock_us(); }
+inline unsigned long millis() { return (unsigned long)(arduino_host::clock_us() / 1000); }
+inline void delayMicroseconds(unsigned int us) { arduino_host::advance(us); }
+inline void delay(unsigned long ms) { arduino_host::advance((uint64_t)ms * 1000); }
+
+inline void noInterrupts() {}
+inline void interrupts() {}
+
+class HardwareSerial
+{
+public:
+    void begin(unsigned long) {}
+    size_t print(const char* s) { return fprintf(stderr, "%s", s); }
+    size_t print(int v) { return fprintf(stderr, "%d", v); }
+    size_t print(unsigned int v) { return fprintf(stderr, "%u", v); }
+    size_t print(long v) { return fprintf(stderr, "%ld", v); }
+    size_t print(unsigned long v) { return fprintf(stderr, "%lu", v); }
+    size_t print(double v) { return fprintf(stderr, "%f", v); }
+    template <typename T> size_t println(const T& v) { return print(v) + println(); }
+    size_t println() { return fprintf(stderr, "\n"); }
+};
+
+static HardwareSerial Serial;
+
+#endif // DRV2667_HOST_ARDUINO_H
@@ -0,0 +1,225 @@
+#pragma once
+#ifndef DRV2667_HOST_DRV2667SIM_H
+#define DRV2667_HOST_DRV2667SIM_H
+
+#include "Arduino.h"
+#include "DRV2667/Effect.h"
+#include "DRV2667/Renderer.h"
+#include <vector>
+#include <string.h>
+
+namespace arduino_host
+{
+    // I2C target on the simulated bus
+    class I2CDevice
+    {
+    public:
+        virtual ~I2CDevice() {}
+        virtual uint8_t address() const = 0;
+        // bytes after the address byte of a write transaction
+        virtual void onWrite(const uint8_t* data, const size_t size) = 0;
+        // next byte of a read transaction
+        virtual uint8_t onRead() = 0;
+        // devices answering to addr, reachable through this one (itself included)
+        virtual void collect(const uint8_t addr, std::vector<I2CDevice*>& out)
+        {
+            if (address() == addr) out.push_back(this);
+        }
+    };
+
+    // TCA9548A / PCA9548A : devices on enabled channels are reachable from the upstream bus
+    class I2CMuxSim : public I2CDevice
+    {
+    public:
+
+        explicit I2CMuxSim(const uint8_t addr = 0x70) : addr_(addr) {}
+
+        void attach(const uint8_t channel, I2CDevice& dev) { channels_[channel].push_back(&dev); }
+
+        uint8_t address() const override { return addr_; }
+        void onWrite(const uint8_t* data, const size_t size) override { if (size) mask_ = data[size - 1]; }
+        uint8_t onRead() override { return mask_; }
+
+        void collect(const uint8_t addr, std::vector<I2CDevice*>& out) override
+        {
+            if (addr == addr_)
+            {
+                out.push_back(this);
+                return;
+            }
+            for (uint8_t ch = 0; ch < 8; ++ch)
+                if (mask_ & (1 << ch))
+                    for (auto* d : channels_[ch]) d->collect(addr, out);
+        }
+
+        uint8_t selected() const { return mask_; }
+
+    private:
+
+        uint8_t addr_;
+        uint8_t mask_ {0};
+        std::vector<I2CDevice*> channels_[8];
+    };
+
+    // register map, page switching, 2 KB RAM and FIFO of the DRV2667
+    // GO stays set for the playback time of the sequence (DRV2667::Renderer over the simulated RAM)
+    class DRV2667Sim : public I2CDevice
+    {
+    public:
+
+        static const uint8_t NUM_REGS = 0x0C;
+        static const uint8_t NUM_PAGES = 8;
+        static const uint16_t RAM_SIZE = 2048;
+        static const uint8_t FIFO_SIZE = 100;
+        static const uint32_t MAX_PLAY_SAMPLES = 8000 * 600; // longer playback is treated as endless
+
+        explicit DRV2667Sim(const uint8_t addr = 0x59) : addr_(addr) { powerOn(); }
+
+        // power cycle : registers to defaults, RAM cleared
+        void powerOn()
+        {
+            memset(ram_, 0, sizeof(ram_));
+            resetRegisters();
+            go_count_ = 0;
+            fifo_overflows_ = 0;
+            fifo_samples_ = 0;
+        }
+
+        uint8_t address() const override { return addr_; }
+
+        void onWrite(const uint8_t* data, const size_t size) override
+        {
+            if (size == 0) return;
+            ptr_ = data[0];
+            for (size_t i = 1; i < size; ++i)
+            {
+                store(ptr_, data[i]);
+                if (!(page_ == 0 && ptr_ == 0x0B)) ++ptr_; // FIFO does not auto-increment
+            }
+        }
+
+        uint8_t onRead() override
+        {
+            const uint8_t v = load(ptr_);
+            ++ptr_;
+            return v;
+        }
+
+        // inspection
+
+        uint8_t reg(const uint8_t r) const { return regs_[r]; }
+        uint8_t page() const { return page_; }
+        const uint8_t* ram() const { return ram_; }
+        uint8_t ram(const uint16_t addr) const { return ram_[addr]; }
+        void corruptRAM(const uint16_t addr, const uint8_t v) { ram_[addr] = v; }
+
+        uint32_t goCount() const { return go_count_; }
+        bool isPlaying() const { return playing_ && (play_forever_ || clock_us() < play_end_us_); }
+        uint32_t fifoSamples() const { return fifo_samples_; }
+        uint32_t fifoOverflows() const { return fifo_overflows_; }
+        uint8_t fifoLevel() { consumeFifo(); return fifo_level_; }
+
+    private:
+
+        void resetRegisters()
+        {
+            memset(regs_, 0, sizeof(regs_));
+            regs_[0x01] = 0x38;
+            regs_[0x02] = 0x40;
+            page_ = 0;
+            ptr_ = 0;
+            fifo_level_ = 0;
+            fifo_us_ = clock_us();
+            playing_ = false;
+        }
+
+        void store(const uint8_t r, const uint8_t v)
+        {
+            if (r == 0xFF) { page_ = v; return; }
+            if (page_ >= 1 && page_ <= NUM_PAGES)
+            {
+                ram_[(page_ - 1) * 256 + r] = v;
+                return;
+            }
+            if (page_ != 0 || r >= NUM_REGS || r == 0x00) return; // invalid page / read only
+
+            if (r == 0x0B)
+            {
+                consumeFifo();
+                if (fifo_level_ >= FIFO_SIZE) { ++fifo_overflows_; return; }
+                if (fifo_level_ == 0) fifo_us_ = clock_us();
+                ++fifo_level_;
+                ++fifo_samples_;
+                return;
+            }
+            if (r == 0x02 && (v & 0x80))
+            {
+                resetRegisters();
+                return;
+            }
+            if (r == 0x02)
+            {
+                if (v & 0x01) startPlayback();
+                else          playing_ = false; // clearing GO stops playback
+                regs_[r] = v & ~0x01;
+                return;
+            }
+            regs_[r] = v;
+        }
+
+        uint8_t load(const uint8_t r)
+        {
+            if (r == 0xFF) return page_;
+            if (page_ >= 1 && page_ <= NUM_PAGES) return ram_[(page_ - 1) * 256 + r];
+            if (page_ != 0 || r >= NUM_REGS) return 0x00;
+            if (r == 0x00)
+            {
+                consumeFifo();
+                return (fifo_level_ >= FIFO_SIZE) ? 0x01 : 0x00; // FIFO_FULL
+            }
+            if (r == 0x02) return regs_[r] | (isPlaying() ? 0x01 : 0x00);
+            return regs_[r];
+        }
+
+        void startPlayback()
+        {
+            ++go_count_;
+            EmbeddedDevices::DRV2667::Sequence seq;
+            memcpy(seq.ids, regs_ + 0x03, sizeof(seq.ids));
+            EmbeddedDevices::DRV2667::Renderer renderer(ram_, RAM_SIZE);
+            uint8_t buf[256];
+            uint64_t n = 0;
+            renderer.start(seq);
+            while (!renderer.done() && n < MAX_PLAY_SAMPLES) n += renderer.render(buf, sizeof(buf));
+            playing_ = true;
+            play_forever_ = !renderer.done();
+            play_end_us_ = clock_us() + n * 125;
+        }
+
+        // 8 kHz playback drains the FIFO
+        void consumeFifo()
+        {
+            const uint64_t consumed = (clock_us() - fifo_us_) / 125;
+            if (consumed == 0) return;
+            fifo_level_ = (consumed >= fifo_level_) ? 0 : uint8_t(fifo_level_ - consumed);
+            fifo_us_ += consumed * 125;
+        }
+
+        uint8_t addr_;
+        uint8_t regs_[NUM_REGS];
+        uint8_t ram_[RAM_SIZE];
+        uint8_t page_;
+        uint8_t ptr_;
+
+        uint8_t fifo_level_;
+        uint64_t fifo_us_;
+        uint32_t fifo_samples_;
+        uint32_t fifo_overflows_;
+        uint32_t go_count_;
+        bool playing_;
+        bool play_forever_;
+        uint64_t play_end_us_;
+    };
+}
+
+#endif // DRV2667_HOST_DRV2667SIM_H
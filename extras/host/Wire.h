@@ -0,0 +1,188 @@
+#pragma once
+#ifndef DRV2667_HOST_WIRE_H
+#define DRV2667_HOST_WIRE_H
+
+// simulated TwoWire for host builds
+// - models a DRV2667 (DRV2667Sim) at 0x59, more devices (e.g. I2CMuxSim with DRV2667s behind it) can be attached
+// - records every transaction with timestamp and estimated duration at the configured clock
+// - advances the simulated clock by the bus time
+// - can inject NACKs / errors into upcoming transactions
+
+#include "Arduino.h"
+#include "DRV2667Sim.h"
+#include <vector>
+
+#ifndef BUFFER_LENGTH
+#define BUFFER_LENGTH 32
+#endif
+
+namespace arduino_host
+{
+    struct Transaction
+    {
+        uint64_t us;                // timestamp at start
+        uint32_t duration_us;       // estimated bus time
+        uint8_t addr;
+        bool read;
+        bool stop;
+        uint8_t status;             // endTransmission() result, 2 for NACKed reads
+        std::vector<uint8_t> bytes; // written or received bytes (without address)
+    };
+}
+
+class TwoWire
+{
+public:
+
+    TwoWire() { attach(device); }
+
+    void begin() {}
+    void begin(int, int) {}
+    void begin(int, int, uint32_t hz) { setClock(hz); }
+    void setClock(const uint32_t hz) { clock_hz_ = hz; }
+    uint32_t getClock() const { return clock_hz_; }
+
+    void beginTransmission(const uint8_t addr)
+    {
+        tx_addr_ = addr;
+        tx_.clear();
+        tx_overflow_ = false;
+    }
+    void beginTransmission(const int addr) { beginTransmission((uint8_t)addr); }
+
+    size_t write(const uint8_t b)
+    {
+        if (tx_.size() >= BUFFER_LENGTH)
+        {
+            tx_overflow_ = true;
+            return 0;
+        }
+        tx_.push_back(b);
+        return 1;
+    }
+    size_t write(const uint8_t* data, const size_t size)
+    {
+        size_t n = 0;
+        while (n < size && write(data[n])) ++n;
+        return n;
+    }
+
+    uint8_t endTransmission(const bool stop = true)
+    {
+        uint8_t status = tx_overflow_ ? 1 : injected();
+        const std::vector<arduino_host::I2CDevice*> targets = find(tx_addr_);
+        if (status == 0 && targets.empty()) status = 2;
+        if (status == 0)
+            for (auto* dev : targets) dev->onWrite(tx_.data(), tx_.size()); // broadcast through muxes
+        record(tx_addr_, false, stop, status, tx_);
+        return status;
+    }
+    uint8_t endTransmission(const uint8_t stop) { return endTransmission((bool)stop); }
+
+    uint8_t requestFrom(const uint8_t addr, const uint8_t size, const bool stop = true)
+    {
+        rx_.clear();
+        rx_pos_ = 0;
+        uint8_t status = injected();
+        const std::vector<arduino_host::I2CDevice*> targets = find(addr);
+        if (status == 0 && targets.empty()) status = 2;
+        if (status == 0)
+            for (uint8_t i = 0; i < size && i < BUFFER_LENGTH; ++i) rx_.push_back(targets.front()->onRead());
+        record(addr, true, stop, status, rx_);
+        return (uint8_t)rx_.size();
+    }
+    uint8_t requestFrom(const int addr, const int size) { return requestFrom((uint8_t)addr, (uint8_t)size); }
+
+    int available() const { return (int)(rx_.size() - rx_pos_); }
+    int read() { return (rx_pos_ < rx_.size()) ? rx_[rx_pos_++] : -1; }
+
+    // simulation control
+
+    void attach(arduino_host::I2CDevice& dev) { devices_.push_back(&dev); }
+    void detachAll() { devices_.clear(); }
+
+    // the next `count` transactions after `after` successful ones fail with `status`
+    void injectError(const uint8_t status = 2, const uint32_t count = 1, const uint32_t after = 0)
+    {
+        inject_status_ = status;
+        inject_count_ = count;
+        inject_after_ = after;
+    }
+
+    const std::vector<arduino_host::Transaction>& log() const { return log_; }
+    void setLogging(const bool b) { logging_ = b; }
+    void clearLog()
+    {
+        log_.clear();
+        transactions_ = 0;
+        bytes_ = 0;
+        bus_us_ = 0;
+    }
+
+    uint32_t transactions() const { return transactions_; }
+    uint32_t bytesOnWire() const { return bytes_; } // including address bytes
+    uint64_t busTimeUs() const { return bus_us_; }
+
+    // bus time of a transaction with `bytes` bytes (address included) at `hz`
+    static double transactionTimeUs(const uint32_t bytes, const uint32_t hz)
+    {
+        return (9.0 * bytes + 2.0) * 1e6 / hz; // 8 bits + ACK per byte, START and STOP
+    }
+
+    arduino_host::DRV2667Sim device;
+
+private:
+
+    std::vector<arduino_host::I2CDevice*> find(const uint8_t addr)
+    {
+        std::vector<arduino_host::I2CDevice*> out;
+        for (auto* d : devices_) d->collect(addr, out);
+        return out;
+    }
+
+    uint8_t injected()
+    {
+        if (inject_count_ == 0) return 0;
+        if (inject_after_ > 0)
+        {
+            --inject_after_;
+            return 0;
+        }
+        --inject_count_;
+        return inject_status_;
+    }
+
+    void record(const uint8_t addr, const bool read, const bool stop, const uint8_t status, const std::vector<uint8_t>& bytes)
+    {
+        const uint32_t n = 1 + (uint32_t)bytes.size();
+        const uint32_t us = (uint32_t)(transactionTimeUs(n, clock_hz_) + 0.5);
+        ++transactions_;
+        bytes_ += n;
+        bus_us_ += us;
+        if (logging_) log_.push_back(arduino_host::Transaction {arduino_host::clock_us(), us, addr, read, stop, status, bytes});
+        arduino_host::advance(us);
+    }
+
+    std::vector<arduino_host::I2CDevice*> devices_;
+    std::vector<arduino_host::Transaction> log_;
+    bool logging_ {true};
+
+    uint8_t tx_addr_ {0};
+    std::vector<uint8_t> tx_;
+    bool tx_overflow_ {false};
+    std::vector<uint8_t> rx_;
+    size_t rx_pos_ {0};
+
+    uint32_t clock_hz_ {100000};
+    uint32_t transactions_ {0};
+    uint32_t bytes_ {0};
+    uint64_t bus_us_ {0};
+
+    uint8_t inject_status_ {0};
+    uint32_t inject_count_ {0};
+    uint32_t inject_after_ {0};
+};
+
+static TwoWire Wire;
+
+#endif // DRV2667_HOST_WIRE_H
@@ -0,0 +1,43 @@
+// host build of the library against the simulated TwoWire :
+// g++ -std=c++14 -I. -Iextras/host extras/host/example_host.cpp -o example_host
+
+#include "DRV2667.h"
+
+DRV2667 drv;
+
+int main()
+{
+    drv.attatch(Wire);
+    Wire.setClock(400000);
+
+    DRV2667Synthesizer synth {
+        {255, 0x15, 50, 0x09},
+        {255, 0x17, 50, 0x09},
+    };
+    uint8_t samples[240]; // one effect stays within a RAM page : at most 255 bytes
+    for (uint16_t i = 0; i < sizeof(samples); ++i) samples[i] = (uint8_t)(127.0 * sin(2.0 * PI * i / 40.0));
+
+    drv.addSynthesizer(synth);
+    drv.addWaveform(samples, sizeof(samples));
+    drv.setWaveformOrderAndID(0, 1);
+    drv.gain(DRV2667::Gain::D25V_A288dB);
+    drv.play();
+
+    // RAM of the simulated chip has to match the library image byte for byte
+    const auto& effects = drv.getEffects();
+    uint16_t mismatch = 0;
+    for (uint16_t i = 0; i < effects.getImageSize(); ++i)
+        if (Wire.device.ram(i) != effects.image()[i]) ++mismatch;
+
+    printf("image : %u bytes, mismatch : %u\n", effects.getImageSize(), mismatch);
+    printf("bus   : %u transactions, %u bytes, %llu us @ %u Hz\n",
+        Wire.transactions(), Wire.bytesOnWire(), (unsigned long long)Wire.busTimeUs(), Wire.getClock());
+
+    for (const auto& t : Wire.log())
+    {
+        printf("%8llu us  %s 0x%02X  status %u :", (unsigned long long)t.us, t.read ? "R" : "W", t.addr, t.status);
+        for (size_t i = 0; i < t.bytes.size() && i < 8; ++i) printf(" %02X", t.bytes[i]);
+        printf("%s\n", (t.bytes.size() > 8) ? " ..." : "");
+    }
+    return mismatch ? 1 : 0;
+}
@@ -0,0 +1,133 @@
+// effect pack builder / inspector
+// g++ -std=c++14 -O2 -I. -Iextras/host extras/pack/drv2667pack.cpp -o drv2667pack
+//
+// ./drv2667pack -o library.pack click.wav buzz.wav ramp.csv   compile inputs (see extras/compiler) into one pack
+// ./drv2667pack --info library.pack                             list effects of a pack (mmap, no copy)
+//
+// effects are named after their file, inputs compiled to several segments get "name.1", "name.2", ...
+
+#include "DRV2667.h"
+#include "DRV2667/Compiler.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <fstream>
+#include <iostream>
+
+using namespace EmbeddedDevices::DRV2667;
+
+namespace
+{
+    std::string stem(const std::string& path)
+    {
+        const size_t slash = path.find_last_of('/');
+        std::string s = (slash == std::string::npos) ? path : path.substr(slash + 1);
+        const size_t dot = s.find_last_of('.');
+        return (dot == std::string::npos) ? s : s.substr(0, dot);
+    }
+
+    bool endsWith(const std::string& s, const char* ext)
+    {
+        const size_t n = strlen(ext);
+        return s.size() >= n && s.compare(s.size() - n, n, ext) == 0;
+    }
+
+    bool compile(const std::string& path, compiler::Program& prog)
+    {
+        if (endsWith(path, ".csv"))
+        {
+            std::vector<compiler::EnvelopePoint> env;
+            if (!compiler::readEnvelope(path, env)) return false;
+            prog = compiler::compileEnvelope(env);
+            return true;
+        }
+        std::vector<float> pcm;
+        uint32_t rate = 0;
+        if (!compiler::readWav(path, pcm, rate)) return false;
+        const std::vector<float> x = compiler::resample(pcm.data(), pcm.size(), rate);
+        prog = compiler::compilePCM(x.data(), x.size());
+        return true;
+    }
+
+    int info(const char* path)
+    {
+        const int fd = open(path, O_RDONLY);
+        struct stat st;
+        if (fd < 0 || fstat(fd, &st) != 0)
+        {
+            std::cerr << "cannot open " << path << std::endl;
+            return 1;
+        }
+        void* p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (p == MAP_FAILED) return 1;
+
+        EffectPack pack((const uint8_t*)p, (uint32_t)st.st_size);
+        if (!pack.valid())
+        {
+            std::cerr << path << " : not a valid effect pack" << std::endl;
+            munmap(p, st.st_size);
+            return 1;
+        }
+        std::cout << (unsigned)pack.effects() << " effects, " << pack.size() << " bytes of RAM image" << std::endl;
+        for (uint8_t id = 1; id <= pack.effects(); ++id)
+        {
+            const uint32_t d = pack.getDurationSamples(id);
+            std::cout << "  " << (unsigned)id << " : " << (pack.name(id) ? pack.name(id) : "-") << ", ";
+            if (d == INFINITE_SAMPLES) std::cout << "endless" << std::endl;
+            else                       std::cout << d / 8.f << " ms" << std::endl;
+        }
+        munmap(p, st.st_size);
+        return 0;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    std::string output = "effects.pack";
+    std::vector<std::string> inputs;
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string a = argv[i];
+        if (a == "--info" && i + 1 < argc) return info(argv[i + 1]);
+        if (a == "-o" && i + 1 < argc) output = argv[++i];
+        else inputs.push_back(a);
+    }
+    if (inputs.empty())
+    {
+        std::cerr << "usage : drv2667pack -o out.pack input.wav|input.csv ...  |  drv2667pack --info file.pack" << std::endl;
+        return 1;
+    }
+
+    Effects effects;
+    std::vector<std::string> names;
+    for (const auto& path : inputs)
+    {
+        compiler::Program prog;
+        if (!compile(path, prog))
+        {
+            std::cerr << "cannot read " << path << std::endl;
+            return 1;
+        }
+        for (size_t k = 0; k < prog.segments.size(); ++k)
+        {
+            const compiler::Segment& s = prog.segments[k];
+            const bool ok = (s.mode == PlayMode::Synthesis)
+                ? effects.append((const Chunk*)s.bytes.data(), uint16_t(s.bytes.size() / 4))
+                : effects.append(s.bytes.data(), (uint16_t)s.bytes.size());
+            if (!ok)
+            {
+                std::cerr << path << " does not fit : " << effects.freeBytes() << " bytes left" << std::endl;
+                return 2;
+            }
+            names.push_back(k ? stem(path) + "." + std::to_string(k) : stem(path));
+        }
+    }
+
+    const std::vector<uint8_t> pack = makePack(effects, names);
+    std::ofstream(output, std::ios::binary).write((const char*)pack.data(), pack.size());
+    std::cerr << output << " : " << (unsigned)effects.size() << " effects, " << pack.size() << " bytes ("
+              << effects.getImageSize() << " bytes of RAM image)" << std::endl;
+    return 0;
+}